@@ -0,0 +1,52 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+#include "busSequencer.pio.h"
+
+BusSequencer::BusSequencer(Logging *pLogging)
+{
+  m_pLog=pLogging;
+  m_pio=pio1; // PIO0 is used by PicoDVI
+  m_offset=pio_add_program(m_pio,&busSequencer_program);
+  m_sm=pio_claim_unused_sm(m_pio,true);
+}
+
+BusSequencer::~BusSequencer()
+{
+}
+
+// Hands the data lines, OE of U5/U6/U7 and PHI2 over to the state machine. The 65C02 is expected
+// to be out of RESET already (see RpPetra::ResetCPU), so the first word pushed is a valid bus cycle.
+void BusSequencer::Start()
+{
+  pio_sm_config config=busSequencer_program_get_default_config(m_offset);
+  sm_config_set_in_pins(&config,0); // GPIO0-7 data lines, 8-10 OE, 11 R/W
+  sm_config_set_out_pins(&config,0,8);
+  sm_config_set_sideset_pins(&config,8); // OE U5, U6 and U7
+  sm_config_set_set_pins(&config,CLK,1);
+  sm_config_set_jmp_pin(&config,RW);
+  sm_config_set_in_shift(&config,false,false,32); // shift left, no autopush
+  sm_config_set_out_shift(&config,true,false,32); // shift right, no autopull
+  sm_config_set_clkdiv_int_frac(&config,BUS_SEQUENCER_CLKDIV,0);
+
+  // Start with PHI2 high and all transceivers in Z-state, data lines are inputs
+  pio_sm_set_pins_with_mask(m_pio,m_sm,disableU5U6U7 | (1u << CLK),pioMaskOE_U5_U6_U7 | (1u << CLK));
+  pio_sm_set_pindirs_with_mask(m_pio,m_sm,pioMaskOE_U5_U6_U7 | (1u << CLK),pioMaskData_U5_U6_U7 | pioMaskOE_U5_U6_U7 | (1u << CLK));
+  for (uint pin=0;pin<RW;pin++)
+  {
+    pio_gpio_init(m_pio,pin);
+  }
+  pio_gpio_init(m_pio,CLK);
+
+  pio_sm_init(m_pio,m_sm,m_offset+busSequencer_offset_entry,&config);
+  pio_sm_set_enabled(m_pio,m_sm,true);
+}
+
+// Stops the state machine, the pins have to be given back to SIO by gpio_init_mask() afterwards.
+void BusSequencer::Stop()
+{
+  pio_sm_set_enabled(m_pio,m_sm,false);
+  pio_sm_clear_fifos(m_pio,m_sm);
+}
@@ -0,0 +1,34 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Driver for the PIO program in busSequencer.pio. The state machine clocks the
+ * 65C02 and multiplexes U5/U6/U7, RpPetra::Clk() only picks up the packed bus
+ * cycle from the RX FIFO and answers read cycles via the TX FIFO.
+*/
+
+#ifndef _BUS_SEQUENCER_HXX
+#define _BUS_SEQUENCER_HXX
+
+// PIO clock divider, sys_clk/2 gives the transceivers enough time to settle.
+#define BUS_SEQUENCER_CLKDIV 2
+
+class BusSequencer {
+
+  private:
+    Logging *m_pLog;
+    PIO m_pio;
+    uint m_sm;
+    uint m_offset;
+
+  public:
+    BusSequencer(Logging *pLogging);
+    virtual ~BusSequencer();
+    void Start();
+    void Stop();
+    // Blocks until the 65C02 has put the next bus cycle onto the bus (PHI2 high).
+    inline uint32_t NextCycle() { return pio_sm_get_blocking(m_pio, m_sm); };
+    // Answers a read cycle, the state machine drives the byte until PHI2 falls.
+    inline void Reply(uint8_t byte) { pio_sm_put(m_pio, m_sm, byte); };
+};
+
+#endif
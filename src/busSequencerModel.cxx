@@ -0,0 +1,274 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+typedef enum {
+  OpSetPins,
+  OpMovOsrNull,
+  OpMovOsrInvNull,
+  OpOutPindirs,
+  OpOutPins,
+  OpInPins,
+  OpInNull,
+  OpNop,
+  OpJmp,
+  OpJmpPin,
+  OpPushBlock,
+  OpPullBlock
+} BusModelOp;
+
+typedef struct {
+  BusModelOp op;
+  uint8_t arg;      // bit count, SET value or jump target
+  uint8_t sideSet;  // OE U7, U6, U5
+  uint8_t delay;
+} BusModelInstruction;
+
+#define BUS_MODEL_ENTRY 0
+#define BUS_MODEL_READ 12
+
+// Same listing as busSequencer.pio, the wrap is from the last instruction back to entry.
+static const BusModelInstruction busSequencerProgram[]={
+  {OpSetPins,0,0b011,1},        // entry: PHI2 falls, U7 kept enabled for data hold time
+  {OpMovOsrNull,0,0b111,3},     // all transceivers to Z
+  {OpOutPindirs,8,0b111,3},     // data lines are inputs on the RP2040 side
+  {OpSetPins,1,0b110,3},        // PHI2 rises, U5 (A0-A7) enabled
+  {OpInPins,12,0b110,0},        // sample A0-A7 and R/W
+  {OpNop,0,0b101,3},            // U6 (A8-A15) enabled
+  {OpInPins,8,0b101,0},         // sample A8-A15
+  {OpJmpPin,BUS_MODEL_READ,0b111,0},
+  {OpNop,0,0b011,3},            // write: U7 enabled, 65C02 drives D0-D7
+  {OpInPins,8,0b011,0},         // sample D0-D7
+  {OpPushBlock,0,0b011,0},
+  {OpJmp,BUS_MODEL_ENTRY,0b011,0},
+  {OpInNull,8,0b111,0},         // read:
+  {OpPushBlock,0,0b111,0},
+  {OpPullBlock,0,0b111,0},      // wait for the reply byte
+  {OpOutPins,8,0b111,0},
+  {OpMovOsrInvNull,0,0b111,0},
+  {OpOutPindirs,8,0b011,3}      // drive D0-D7 towards the 65C02 via U7
+};
+
+constexpr uint8_t busModelProgramLength=sizeof(busSequencerProgram)/sizeof(busSequencerProgram[0]);
+
+BusSequencerModel::BusSequencerModel(HostCpu *pCpu)
+{
+  m_pCpu=pCpu;
+  Reset();
+}
+
+BusSequencerModel::~BusSequencerModel()
+{
+}
+
+// Same state as after BusSequencer::Start(): PHI2 high, all transceivers in Z-state
+void BusSequencerModel::Reset()
+{
+  m_pc=BUS_MODEL_ENTRY;
+  m_delay=0;
+  m_isr=m_osr=0;
+  m_rxHead=m_rxCount=0;
+  m_txHead=m_txCount=0;
+  m_phi2=true;
+  m_oe=0b111;
+  m_dataOut=0;
+  m_dataDir=0;
+  m_isCycleValid=false;
+  m_holdClocks=0;
+  m_addr=0;
+  m_readNotWrite=true;
+  m_cpuData=0;
+  m_clocks=m_busCycles=m_stalls=0;
+  m_contentions=0;
+  m_sync[0]=m_sync[1]=PinLevels();
+}
+
+// Level of the 65C02 data bus (U7 B-side) as seen by the 65C02 on a read cycle
+uint8_t BusSequencerModel::CpuDataBus()
+{
+  if ((m_oe & 0b100)==0 && m_dataDir==0xff)
+  {
+    return m_dataOut;
+  }
+  return 0xff; // floating
+}
+
+// Levels of GPIO0-11 as driven right now
+uint32_t BusSequencerModel::PinLevels()
+{
+  uint8_t drivers=0;
+  uint8_t data=0xff; // floating
+  
+  if (m_dataDir!=0)
+  {
+    data=m_dataOut;
+    drivers++;
+  }
+  if ((m_oe & 0b001)==0) // U5
+  {
+    data=m_addr & 0xff;
+    drivers++;
+  }
+  if ((m_oe & 0b010)==0) // U6
+  {
+    data=m_addr >> 8;
+    drivers++;
+  }
+  if ((m_oe & 0b100)==0 && !m_readNotWrite) // U7, 65C02 writes
+  {
+    data=m_cpuData;
+    drivers++;
+  }
+  if (drivers>1)
+  {
+    m_contentions++;
+  }
+  return data | (m_oe << 8) | (m_readNotWrite ? (1u << RW) : 0);
+}
+
+void BusSequencerModel::Step()
+{
+  m_clocks++;
+  // The 65C02 keeps address and R/W for its hold time after PHI2 has fallen
+  if (m_holdClocks>0 && --m_holdClocks==0)
+  {
+    m_addr=m_nextAddr;
+    m_readNotWrite=m_nextReadNotWrite;
+    m_cpuData=m_nextCpuData;
+  }
+  // 2-cycle input synchroniser
+  m_sync[1]=m_sync[0];
+  m_sync[0]=PinLevels();
+
+  if (m_delay>0)
+  {
+    m_delay--;
+    return;
+  }
+
+  const BusModelInstruction *pInstr=&busSequencerProgram[m_pc];
+  uint8_t next=(m_pc+1) % busModelProgramLength;
+  uint32_t mask=(1u << pInstr->arg)-1;
+
+  m_oe=pInstr->sideSet; // side-set takes effect even if the instruction stalls
+  switch (pInstr->op)
+  {
+    case OpSetPins:
+      if (m_phi2 && pInstr->arg==0)
+      {
+        if (m_isCycleValid)
+        {
+          if (m_readNotWrite)
+          {
+            m_pCpu->Latch(CpuDataBus());
+          }
+          m_busCycles++;
+        }
+        m_pCpu->NextCycle(&m_nextAddr,&m_nextReadNotWrite,&m_nextCpuData);
+        m_holdClocks=BUS_MODEL_CPU_HOLD;
+        m_isCycleValid=true;
+      }
+      m_phi2=pInstr->arg;
+    break;
+
+    case OpMovOsrNull:
+      m_osr=0;
+    break;
+
+    case OpMovOsrInvNull:
+      m_osr=0xffffffff;
+    break;
+
+    case OpOutPindirs:
+      m_dataDir=m_osr & mask;
+      m_osr>>=pInstr->arg;
+    break;
+
+    case OpOutPins:
+      m_dataOut=m_osr & mask;
+      m_osr>>=pInstr->arg;
+    break;
+
+    case OpInPins:
+      m_isr=(m_isr << pInstr->arg) | (m_sync[1] & mask);
+    break;
+
+    case OpInNull:
+      m_isr<<=pInstr->arg;
+    break;
+
+    case OpNop:
+    break;
+
+    case OpJmp:
+      next=pInstr->arg;
+    break;
+
+    case OpJmpPin:
+      if (m_sync[1] & (1u << RW))
+      {
+        next=pInstr->arg;
+      }
+    break;
+
+    case OpPushBlock:
+      if (m_rxCount==BUS_MODEL_FIFO_DEPTH)
+      {
+        m_stalls++;
+        return;
+      }
+      m_rxFifo[(m_rxHead+m_rxCount++) % BUS_MODEL_FIFO_DEPTH]=m_isr;
+      m_isr=0;
+    break;
+
+    case OpPullBlock:
+      if (m_txCount==0)
+      {
+        m_stalls++;
+        return;
+      }
+      m_osr=m_txFifo[m_txHead];
+      m_txHead=(m_txHead+1) % BUS_MODEL_FIFO_DEPTH;
+      m_txCount--;
+    break;
+  }
+  m_pc=next;
+  m_delay=pInstr->delay;
+}
+
+bool BusSequencerModel::Get(uint32_t *pBusWord)
+{
+  if (m_rxCount==0)
+  {
+    return false;
+  }
+  *pBusWord=m_rxFifo[m_rxHead];
+  m_rxHead=(m_rxHead+1) % BUS_MODEL_FIFO_DEPTH;
+  m_rxCount--;
+  return true;
+}
+
+bool BusSequencerModel::Put(uint8_t byte)
+{
+  if (m_txCount==BUS_MODEL_FIFO_DEPTH)
+  {
+    return false;
+  }
+  m_txFifo[(m_txHead+m_txCount++) % BUS_MODEL_FIFO_DEPTH]=byte;
+  return true;
+}
+
+bool BusSequencerModel::GetBlocking(uint32_t *pBusWord)
+{
+  while (!Get(pBusWord))
+  {
+    if (busSequencerProgram[m_pc].op==OpPullBlock && m_delay==0 && m_txCount==0)
+    {
+      return false;
+    }
+    Step();
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Cycle-accurate software model of busSequencer.pio. It is not part of the firmware, it
+ * lets the PIO handshake with RpPetra::Clk() run on a Linux host. One Step() is one PIO
+ * clock (sys_clk/BUS_SEQUENCER_CLKDIV), including delay cycles, side-set, stalls on
+ * full/empty FIFOs and the 2-cycle input synchroniser.
+*/
+
+#ifndef _BUS_SEQUENCER_MODEL_HXX
+#define _BUS_SEQUENCER_MODEL_HXX
+
+#define BUS_MODEL_FIFO_DEPTH 4
+// PIO clocks (~8ns each) the 65C02 holds address and R/W after PHI2 has fallen
+#define BUS_MODEL_CPU_HOLD 3
+
+class BusSequencerModel {
+
+  private:
+    HostCpu *m_pCpu;   // The 65C02 side of the model
+    // State machine
+    uint8_t m_pc;
+    uint8_t m_delay;
+    uint32_t m_isr;
+    uint32_t m_osr;
+    uint32_t m_rxFifo[BUS_MODEL_FIFO_DEPTH];
+    uint32_t m_txFifo[BUS_MODEL_FIFO_DEPTH];
+    uint8_t m_rxHead, m_rxCount;
+    uint8_t m_txHead, m_txCount;
+    uint32_t m_sync[2];
+    // Pins
+    bool m_phi2;
+    uint8_t m_oe;       // side-set, OE U5 (bit 0), U6 (bit 1), U7 (bit 2), active low
+    uint8_t m_dataOut;  // GPIO0-7 output levels
+    uint8_t m_dataDir;  // GPIO0-7 directions, 1=output
+    // 65C02 bus
+    bool m_isCycleValid;
+    uint16_t m_addr;
+    bool m_readNotWrite;
+    uint8_t m_cpuData;
+    uint8_t m_holdClocks;
+    uint16_t m_nextAddr;
+    bool m_nextReadNotWrite;
+    uint8_t m_nextCpuData;
+    // Statistics
+    uint64_t m_clocks;
+    uint64_t m_busCycles;
+    uint64_t m_stalls;
+    uint32_t m_contentions;
+
+    uint32_t PinLevels();
+    uint8_t CpuDataBus();
+
+  public:
+    BusSequencerModel(HostCpu *pCpu);
+    virtual ~BusSequencerModel();
+    void Reset();
+    void Step();
+    // Counterparts of pio_sm_get()/pio_sm_put(), false if the FIFO is empty/full.
+    bool Get(uint32_t *pBusWord);
+    bool Put(uint8_t byte);
+    // Steps until a bus cycle is available. Returns false if the state machine waits for
+    // a reply that has not been put (that would hang pio_sm_get_blocking() on the target).
+    bool GetBlocking(uint32_t *pBusWord);
+    inline uint64_t GetClocks() { return m_clocks;};
+    inline uint64_t GetBusCycles() { return m_busCycles;};
+    inline uint64_t GetStalls() { return m_stalls;};
+    // Number of PIO clocks where more than one driver was active on GPIO0-7
+    inline uint32_t GetContentions() { return m_contentions;};
+};
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+BusTrace::BusTrace()
+{
+  m_head=0;
+  m_tail=0;
+  m_enabled=false;
+  m_magicSent=false;
+  m_dropped=0;
+  m_lastCycle=0;
+  m_lastAddr=0;
+  m_pendingPos=0;
+  m_pendingSize=0;
+}
+
+BusTrace::~BusTrace()
+{
+}
+
+void BusTrace::Start()
+{
+  m_enabled=true;
+}
+
+size_t BusTrace::Encode(uint8_t *pOut, size_t size)
+{
+  size_t pos=0;
+  if (!m_magicSent)
+  {
+    if (size<sizeof(BUS_TRACE_MAGIC)-1)
+    {
+      return 0;
+    }
+    memcpy(pOut,BUS_TRACE_MAGIC,sizeof(BUS_TRACE_MAGIC)-1);
+    pos=sizeof(BUS_TRACE_MAGIC)-1;
+    m_magicSent=true;
+  }
+  uint32_t tail=m_tail;
+  uint32_t head=m_head;
+  __compiler_memory_barrier();
+  while (tail!=head && size-pos>=BUS_TRACE_MAX_RECORD)
+  {
+    const Entry *pEntry=&m_entries[tail & (BUS_TRACE_ENTRIES-1)];
+    uint32_t delta=pEntry->cycle-m_lastCycle;
+    uint16_t addr=pEntry->bus & 0xffff;
+    uint8_t tag=(pEntry->bus & (1<<24)) ? BUS_TRACE_READ : 0;
+    size_t tagPos=pos++;
+
+    if (delta>=1 && delta<=BUS_TRACE_DELTA_ESCAPE)
+    {
+      tag|=(delta-1)<<BUS_TRACE_DELTA_SHIFT;
+    }
+    else
+    {
+      tag|=BUS_TRACE_DELTA_ESCAPE<<BUS_TRACE_DELTA_SHIFT;
+      do {
+        pOut[pos++]=(delta & 0x7f) | (delta>0x7f ? 0x80 : 0);
+        delta>>=7;
+      } while (delta);
+    }
+    if (addr==(uint16_t)(m_lastAddr+1))
+    {
+      tag|=BUS_TRACE_ADDR_NEXT;
+    }
+    else if (addr==m_lastAddr)
+    {
+      tag|=BUS_TRACE_ADDR_SAME;
+    }
+    else if ((addr & 0xff00)==(m_lastAddr & 0xff00))
+    {
+      tag|=BUS_TRACE_ADDR_PAGE;
+      pOut[pos++]=addr & 0xff;
+    }
+    else
+    {
+      tag|=BUS_TRACE_ADDR_FULL;
+      pOut[pos++]=addr & 0xff;
+      pOut[pos++]=addr>>8;
+    }
+    pOut[pos++]=(pEntry->bus>>16) & 0xff;
+    pOut[tagPos]=tag;
+
+    m_lastCycle=pEntry->cycle;
+    m_lastAddr=addr;
+    tail++;
+  }
+  __compiler_memory_barrier();
+  m_tail=tail;
+  return pos;
+}
+
+#ifndef _HOST
+void BusTrace::InitUart()
+{
+  uart_init(BUS_TRACE_UART,BUS_TRACE_BAUD);
+  gpio_set_function(BUS_TRACE_TX_PIN,GPIO_FUNC_UART);
+}
+
+// Scheduler event: tops up the UART FIFO, never waits for it
+void __not_in_flash_func(BusTrace::Drain)(void *pContext, uint64_t cycle)
+{
+  BusTrace *pTrace=(BusTrace *)pContext;
+  while (uart_is_writable(BUS_TRACE_UART))
+  {
+    if (pTrace->m_pendingPos==pTrace->m_pendingSize)
+    {
+      pTrace->m_pendingPos=0;
+      pTrace->m_pendingSize=pTrace->Encode(pTrace->m_pending,sizeof(pTrace->m_pending));
+      if (pTrace->m_pendingSize==0)
+      {
+        return;
+      }
+    }
+    uart_putc_raw(BUS_TRACE_UART,pTrace->m_pending[pTrace->m_pendingPos++]);
+  }
+}
+#endif
+
+#ifdef _HOST
+// Reads a stream written by Encode() back, false if the file cannot be read or is no bus trace
+bool ReadBusTrace(const char *pFileName, std::vector<BusTraceRecord> &records)
+{
+  FILE *pFile=fopen(pFileName,"rb");
+  if (pFile==nullptr)
+  {
+    perror(pFileName);
+    return false;
+  }
+  std::vector<uint8_t> buffer;
+  uint8_t chunk[65536];
+  size_t size;
+  while ((size=fread(chunk,1,sizeof(chunk),pFile))>0)
+  {
+    buffer.insert(buffer.end(),chunk,chunk+size);
+  }
+  fclose(pFile);
+
+  const size_t magicSize=sizeof(BUS_TRACE_MAGIC)-1;
+  if (buffer.size()<magicSize || memcmp(buffer.data(),BUS_TRACE_MAGIC,magicSize)!=0)
+  {
+    fprintf(stderr,"%s: no bus trace\n",pFileName);
+    return false;
+  }
+  BusTraceRecord record={0,0,0,false};
+  size_t pos=magicSize;
+  while (pos<buffer.size())
+  {
+    size_t start=pos;
+    uint8_t tag=buffer[pos++];
+    uint32_t delta=(tag>>BUS_TRACE_DELTA_SHIFT)+1;
+    if ((tag>>BUS_TRACE_DELTA_SHIFT)==BUS_TRACE_DELTA_ESCAPE)
+    {
+      // LEB128, a 32 bit delta takes 5 bytes at most
+      delta=0;
+      uint8_t byte=0x80;
+      for (int shift=0;(byte & 0x80) && shift<35 && pos<buffer.size();shift+=7)
+      {
+        byte=buffer[pos++];
+        delta|=(uint32_t)(byte & 0x7f)<<shift;
+      }
+      if (byte & 0x80)
+      {
+        pos=start;
+        break; // truncated or more than 5 bytes
+      }
+    }
+    uint8_t mode=tag & 0x03;
+    size_t addrSize=(mode==BUS_TRACE_ADDR_FULL) ? 2 : (mode==BUS_TRACE_ADDR_PAGE) ? 1 : 0;
+    if (pos+addrSize+1>buffer.size())
+    {
+      pos=start;
+      break; // truncated record, no address or data byte
+    }
+    switch (mode)
+    {
+      case BUS_TRACE_ADDR_NEXT:
+        record.addr++;
+        break;
+      case BUS_TRACE_ADDR_PAGE:
+        record.addr=(record.addr & 0xff00) | buffer[pos];
+        break;
+      case BUS_TRACE_ADDR_FULL:
+        record.addr=buffer[pos] | (buffer[pos+1]<<8);
+        break;
+      default:
+        break;
+    }
+    pos+=addrSize;
+    record.data=buffer[pos++];
+    record.read=tag & BUS_TRACE_READ;
+    // The stream only has 32 bit cycles
+    record.cycle+=(uint32_t)delta;
+    records.push_back(record);
+  }
+  if (pos<buffer.size())
+  {
+    // e.g. a UART capture that ends within a record, the records before it are kept
+    fprintf(stderr,"%s: truncated or corrupt record at offset %zu, %zu records read\n",pFileName,pos,records.size());
+  }
+  return true;
+}
+#endif
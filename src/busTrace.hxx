@@ -0,0 +1,105 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Bus trace (_BUS_TRACE): every bus cycle seen by RpPetra::Clk() is put into a
+ * single-producer/single-consumer ring in SRAM. The consumer (a scheduler event on the
+ * board, the main loop on the host) encodes it into the stream below and sends it out
+ * over the UART (UEXT pin 3) or into a file. busTraceDecode.cxx reads the stream back.
+ * 
+ * Stream: "BTR1", then one record per bus cycle:
+ *   tag   bits 7..3 cycle delta-1 (31: LEB128 delta follows), bit 2 R/W (1=read),
+ *         bits 1..0 address (0: previous+1, 1: low byte follows, same page, 2: 16 bit follows, 3: same)
+ *   [delta] [address] data
+ * Every bus cycle is recorded, so a cycle delta >1 means the ring was full.
+*/
+
+#ifndef _BUS_TRACE_HXX
+#define _BUS_TRACE_HXX
+
+#define BUS_TRACE_ENTRIES 4096 // 32 KB, power of 2
+#define BUS_TRACE_MAGIC "BTR1"
+#define BUS_TRACE_MAX_RECORD 9 // tag, 5 byte delta, 2 byte address, data
+
+#define BUS_TRACE_ADDR_NEXT 0
+#define BUS_TRACE_ADDR_PAGE 1
+#define BUS_TRACE_ADDR_FULL 2
+#define BUS_TRACE_ADDR_SAME 3
+#define BUS_TRACE_READ 0x04
+#define BUS_TRACE_DELTA_SHIFT 3
+#define BUS_TRACE_DELTA_ESCAPE 31
+
+#define BUS_TRACE_UART uart0
+#define BUS_TRACE_TX_PIN 28 // UEXT pin 3
+#define BUS_TRACE_BAUD 921600
+#define BUS_TRACE_DRAIN_CYCLES 300 // the 32 byte UART FIFO takes ~350us at 921600 baud
+
+class BusTrace {
+
+  private:
+    typedef struct {
+      uint32_t cycle;
+      uint32_t bus; // bits 0..15 address, 16..23 data, 24 R/W
+    } Entry;
+
+    Entry m_entries[BUS_TRACE_ENTRIES];
+    volatile uint32_t m_head; // written by the producer only
+    volatile uint32_t m_tail; // written by the consumer only
+    bool m_enabled;
+    bool m_magicSent;
+    uint32_t m_dropped;
+    // Encoder state
+    uint32_t m_lastCycle;
+    uint16_t m_lastAddr;
+    // Board: encoded bytes not yet in the UART FIFO
+    uint8_t m_pending[BUS_TRACE_MAX_RECORD];
+    uint8_t m_pendingPos;
+    uint8_t m_pendingSize;
+
+  public:
+    BusTrace();
+    virtual ~BusTrace();
+    void Start();
+    inline void Stop() { m_enabled=false;};
+    inline uint32_t GetDropped() { return m_dropped;};
+
+    // Producer, a handful of instructions per bus cycle
+    inline void Record(uint64_t cycle, uint16_t addr, uint8_t data, bool readNotWrite)
+    {
+      uint32_t head=m_head;
+      if (!m_enabled)
+      {
+        return;
+      }
+      if (head-m_tail>=BUS_TRACE_ENTRIES)
+      {
+        m_dropped++;
+        return;
+      }
+      Entry *pEntry=&m_entries[head & (BUS_TRACE_ENTRIES-1)];
+      pEntry->cycle=(uint32_t)cycle;
+      pEntry->bus=addr | (data<<16) | (readNotWrite<<24);
+      __compiler_memory_barrier();
+      m_head=head+1;
+    };
+
+    // Consumer: encodes whole records into pOut, returns the number of bytes
+    size_t Encode(uint8_t *pOut, size_t size);
+#ifndef _HOST
+    void InitUart();
+    static void Drain(void *pContext, uint64_t cycle);
+#endif
+};
+
+#ifdef _HOST
+// A bus cycle read back from the stream (busTraceDecode, computer_host -a)
+typedef struct {
+  uint64_t cycle;
+  uint16_t addr;
+  uint8_t data;
+  bool read;
+} BusTraceRecord;
+
+bool ReadBusTrace(const char *pFileName, std::vector<BusTraceRecord> &records);
+#endif
+
+#endif
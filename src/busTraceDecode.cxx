@@ -0,0 +1,413 @@
+/**
+ * Decoder for bus traces written by BusTrace (see busTrace.hxx), host build only.
+ *
+ * Usage: busTraceDecode [-d] trace.bin
+ * Prints a summary (gaps, hot pages, I/O register accesses). With -d the trace is
+ * also disassembled. Instruction boundaries are recovered by replaying the 6510 bus
+ * cycle sequences of opcodes6510.hxx, after a gap or a mismatch (e.g. a 65C02-only
+ * cycle in a trace from the board) the decoder resynchronises and counts it.
+ *
+ * Written by Bernd Krekeler, Herne, Germany
+*/
+
+#include "stdinclude.hxx"
+#include <algorithm>
+
+#define RESYNC_CHAIN 4 // instructions in a row that have to match after a resync
+#define HOT_PAGES 16
+
+typedef BusTraceRecord Record;
+
+typedef struct {
+  uint16_t pc;
+  uint8_t opcode;
+  uint8_t operand[2];
+  uint8_t operandSize;
+  uint16_t nextPc;
+  uint16_t vector;   // BRK, IRQ, NMI, RESET
+  bool interrupt;
+  bool jam;
+} Instruction;
+
+static const char *opNames[]={"???",
+  "ORA","AND","EOR","ADC","LDA","CMP","SBC","LDX","LDY","CPX","CPY","BIT","NOP",
+  "LAX","LAS","ANC","ALR","ARR","ANE","LXA","SBX",
+  "STA","STX","STY","SAX","SHA","SHX","SHY","TAS",
+  "ASL","ROL","LSR","ROR","DEC","INC","SLO","RLA","SRE","RRA","DCP","ISC",
+  "TXA","TAX","DEX","TXS","TSX","DEY","TAY","TYA","INY","INX",
+  "CLC","SEC","CLI","SEI","CLV","CLD","SED",
+  "ASL","ROL","LSR","ROR",
+  "BPL","BMI","BVC","BVS","BCC","BCS","BNE","BEQ",
+  "BRK","JSR","RTI","RTS","JMP","PHP","PLP","PHA","PLA","JAM"};
+static_assert(sizeof(opNames)/sizeof(opNames[0])==opJAM+1, "One name per CpuOp");
+
+static inline bool IsStack(const Record &record)
+{
+  return (record.addr & 0xff00)==0x0100;
+}
+
+/**
+ * Replays the bus cycle sequence of the instruction fetched by records[i].
+ * Returns the index of the next opcode fetch, 0 if the records do not fit.
+ */
+static size_t DecodeInstruction(const std::vector<Record> &records, size_t i, Instruction *pInstruction)
+{
+  const size_t count=records.size();
+  const Record &fetch=records[i];
+  if (!fetch.read || i+2>=count)
+  {
+    return 0;
+  }
+  Instruction &instruction=*pInstruction;
+  instruction.pc=fetch.addr;
+  instruction.opcode=fetch.data;
+  instruction.operandSize=0;
+  instruction.vector=0;
+  instruction.jam=false;
+  // IRQ, NMI and RESET run BRK without incrementing PC: the same address is read twice
+  instruction.interrupt=records[i+1].read && records[i+1].addr==fetch.addr && IsStack(records[i+2]);
+  if (instruction.interrupt)
+  {
+    instruction.opcode=0x00;
+  }
+
+  const CpuUop *pSequence=cpuDecodeTable.sequence[instruction.opcode].uop;
+  uint16_t pc=instruction.interrupt ? fetch.addr : fetch.addr+1;
+  uint16_t target=0;
+  uint16_t pulled=0;
+  bool done=false;
+  size_t k=i+1;
+  instruction.nextPc=0;
+
+  for (int step=0;step<CPU_MAX_SEQUENCE && pSequence[step]!=uopEnd && !done;step++,k++)
+  {
+    if (k>=count)
+    {
+      return 0;
+    }
+    const Record &record=records[k];
+    CpuUop uop=pSequence[step];
+    switch (uop)
+    {
+      case uopImplied: case uopDummyPC:
+        if (!record.read || record.addr!=pc) return 0;
+        break;
+      case uopImmediate: case uopAddrLo: case uopAddrHi:
+        if (!record.read || record.addr!=pc) return 0;
+        instruction.operand[instruction.operandSize++]=record.data;
+        pc++;
+        break;
+      case uopJmpAbs: case uopJsrAddrHi:
+        if (!record.read || record.addr!=pc) return 0;
+        instruction.operand[instruction.operandSize++]=record.data;
+        pc=instruction.operand[0] | (record.data<<8);
+        break;
+      case uopBrk:
+        if (!record.read || record.addr!=pc) return 0;
+        if (!instruction.interrupt)
+        {
+          pc++;
+        }
+        break;
+      case uopBranch:
+      {
+        if (!record.read || record.addr!=pc) return 0;
+        instruction.operand[instruction.operandSize++]=record.data;
+        pc++;
+        target=pc+(int8_t)record.data;
+        // Taken: dummy read of PC, then the target or the target with the old PCH
+        uint16_t fixAddr=(pc & 0xff00) | (target & 0xff);
+        bool taken=k+2<count && records[k+1].addr==pc &&
+          (records[k+2].addr==target || records[k+2].addr==fixAddr) && target!=pc+1;
+        done=!taken;
+        break;
+      }
+      case uopBranchTaken:
+        if (!record.read || record.addr!=pc) return 0;
+        if ((target & 0xff00)==(pc & 0xff00))
+        {
+          done=true;
+        }
+        pc=target;
+        break;
+      case uopBranchFix:
+        if (!record.read) return 0;
+        break;
+      case uopIndexXRead: case uopIndexYRead:
+        if (!record.read) return 0;
+        // The read is repeated with the carry in PCH if the page was crossed
+        done=!(k+1<count && records[k+1].read && records[k+1].addr==(uint16_t)(record.addr+0x100));
+        break;
+      case uopJmpIndLo:
+        if (!record.read) return 0;
+        target=record.data;
+        break;
+      case uopJmpIndHi:
+        if (!record.read) return 0;
+        pc=target | (record.data<<8);
+        break;
+      case uopZeroPageX: case uopZeroPageY: case uopPointerX: case uopPointerLo: case uopPointerHi:
+      case uopIndexXDummy: case uopIndexYDummy: case uopRead: case uopRmwRead:
+        if (!record.read) return 0;
+        break;
+      case uopWrite: case uopRmwDummy: case uopRmwWrite:
+        if (record.read) return 0;
+        break;
+      case uopStackDummy:
+        if (!record.read || !IsStack(record)) return 0;
+        break;
+      case uopPushPCH: case uopPushPCL: case uopPushP:
+        // Reads during RESET
+        if (!IsStack(record)) return 0;
+        break;
+      case uopPushA: case uopPushPhp:
+        if (record.read || !IsStack(record)) return 0;
+        break;
+      case uopPullA: case uopPullPlp: case uopPullP:
+        if (!record.read || !IsStack(record)) return 0;
+        break;
+      case uopPullPCL:
+        if (!record.read || !IsStack(record)) return 0;
+        pulled=record.data;
+        break;
+      case uopPullPCH:
+        if (!record.read || !IsStack(record)) return 0;
+        pulled|=record.data<<8;
+        pc=pulled;
+        break;
+      case uopRtsInc:
+        if (!record.read || record.addr!=pulled) return 0;
+        pc=pulled+1;
+        break;
+      case uopVectorLo:
+        if (!record.read || (record.addr!=0xfffa && record.addr!=0xfffc && record.addr!=0xfffe)) return 0;
+        instruction.vector=record.addr;
+        pc=record.data;
+        break;
+      case uopVectorHi:
+        if (!record.read || record.addr!=instruction.vector+1) return 0;
+        pc|=record.data<<8;
+        break;
+      case uopJam:
+        instruction.jam=true;
+        instruction.nextPc=0xffff;
+        return count;
+      default:
+        return 0;
+    }
+  }
+  instruction.nextPc=pc;
+  return k;
+}
+
+// A fetch at records[i] starts a chain of length instructions that match each other
+static bool IsInSync(const std::vector<Record> &records, size_t i, int length)
+{
+  Instruction instruction;
+  for (int n=0;n<length;n++)
+  {
+    size_t next=DecodeInstruction(records,i,&instruction);
+    if (next==0 || next>=records.size())
+    {
+      return next!=0;
+    }
+    if (records[next].addr!=instruction.nextPc || records[next].cycle!=records[next-1].cycle+1)
+    {
+      return false;
+    }
+    i=next;
+  }
+  return true;
+}
+
+static void PrintInstruction(const Record &fetch, const Instruction &instruction)
+{
+  CpuOpcode decoded=DecodeOpcode(instruction.opcode);
+  char operand[16]="";
+  uint8_t lo=instruction.operand[0];
+  uint16_t word=instruction.operand[0] | (instruction.operand[1]<<8);
+
+  if (instruction.interrupt)
+  {
+    printf("%12llu  %04X           %s\n",(unsigned long long)fetch.cycle,instruction.pc,
+      instruction.vector==0xfffa ? "NMI" : (instruction.vector==0xfffc ? "RESET" : "IRQ"));
+    return;
+  }
+  switch (decoded.mode)
+  {
+    case modeImmediate: snprintf(operand,sizeof(operand),"#$%02X",lo); break;
+    case modeZeroPage:  snprintf(operand,sizeof(operand),"$%02X",lo); break;
+    case modeZeroPageX: snprintf(operand,sizeof(operand),"$%02X,X",lo); break;
+    case modeZeroPageY: snprintf(operand,sizeof(operand),"$%02X,Y",lo); break;
+    case modeAbsolute:  snprintf(operand,sizeof(operand),"$%04X",word); break;
+    case modeAbsoluteX: snprintf(operand,sizeof(operand),"$%04X,X",word); break;
+    case modeAbsoluteY: snprintf(operand,sizeof(operand),"$%04X,Y",word); break;
+    case modeIndirectX: snprintf(operand,sizeof(operand),"($%02X,X)",lo); break;
+    case modeIndirectY: snprintf(operand,sizeof(operand),"($%02X),Y",lo); break;
+    case modeIndirect:  snprintf(operand,sizeof(operand),"($%04X)",word); break;
+    case modeRelative:  snprintf(operand,sizeof(operand),"$%04X",(uint16_t)(instruction.pc+2+(int8_t)lo)); break;
+    default:
+      if (instruction.operandSize==2)
+      {
+        snprintf(operand,sizeof(operand),"$%04X",word);
+      }
+      break;
+  }
+  char bytes[12];
+  switch (instruction.operandSize)
+  {
+    case 0:  snprintf(bytes,sizeof(bytes),"%02X",instruction.opcode); break;
+    case 1:  snprintf(bytes,sizeof(bytes),"%02X %02X",instruction.opcode,lo); break;
+    default: snprintf(bytes,sizeof(bytes),"%02X %02X %02X",instruction.opcode,lo,instruction.operand[1]); break;
+  }
+  printf("%12llu  %04X  %-8s  %s%s%s\n",(unsigned long long)fetch.cycle,instruction.pc,bytes,
+    opNames[cpuDecodeTable.op[instruction.opcode]],operand[0] ? " " : "",operand);
+}
+
+static void PrintIO(const char *pChip, uint16_t base, uint16_t registers, const uint32_t *pReads, const uint32_t *pWrites)
+{
+  for (uint16_t reg=0;reg<registers;reg++)
+  {
+    if (pReads[reg] || pWrites[reg])
+    {
+      printf("  %-5s $%04X  %10u reads  %10u writes\n",pChip,base+reg,pReads[reg],pWrites[reg]);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  bool disassemble=argc>2 && strcmp(argv[1],"-d")==0;
+  if (argc<2 || (argc>2 && !disassemble))
+  {
+    fprintf(stderr,"Usage: %s [-d] trace.bin\n",argv[0]);
+    return 2;
+  }
+  std::vector<Record> records;
+  if (!ReadBusTrace(argv[argc-1],records))
+  {
+    return 1;
+  }
+
+  // Summary
+  uint64_t gaps=0, lostCycles=0, reads=0;
+  uint64_t pageCount[256]={0};
+  uint32_t vicReads[0x40]={0}, vicWrites[0x40]={0};
+  uint32_t sidReads[0x20]={0}, sidWrites[0x20]={0};
+  uint32_t cia1Reads[0x10]={0}, cia1Writes[0x10]={0};
+  uint32_t cia2Reads[0x10]={0}, cia2Writes[0x10]={0};
+  uint64_t colorRam=0;
+  for (size_t i=0;i<records.size();i++)
+  {
+    const Record &record=records[i];
+    if (i>0 && record.cycle!=records[i-1].cycle+1)
+    {
+      gaps++;
+      lostCycles+=record.cycle-records[i-1].cycle-1;
+    }
+    reads+=record.read;
+    pageCount[record.addr>>8]++;
+    // $D000-$DFFF may as well be RAM or the character ROM, depending on $01
+    switch (record.addr>>8)
+    {
+      case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+        (record.read ? vicReads : vicWrites)[record.addr & 0x3f]++;
+        break;
+      case 0xd4: case 0xd5: case 0xd6: case 0xd7:
+        (record.read ? sidReads : sidWrites)[record.addr & 0x1f]++;
+        break;
+      case 0xd8: case 0xd9: case 0xda: case 0xdb:
+        colorRam++;
+        break;
+      case 0xdc:
+        (record.read ? cia1Reads : cia1Writes)[record.addr & 0x0f]++;
+        break;
+      case 0xdd:
+        (record.read ? cia2Reads : cia2Writes)[record.addr & 0x0f]++;
+        break;
+    }
+  }
+  if (records.empty())
+  {
+    printf("empty trace\n");
+    return 0;
+  }
+
+  // Instructions
+  uint64_t instructions=0, resyncs=0;
+  Instruction instruction;
+  size_t i=0;
+  bool inSync=false;
+  while (i<records.size())
+  {
+    if (!inSync)
+    {
+      while (i<records.size() && !IsInSync(records,i,RESYNC_CHAIN))
+      {
+        i++;
+      }
+      if (i>=records.size())
+      {
+        break;
+      }
+      inSync=true;
+      if (instructions>0)
+      {
+        resyncs++;
+      }
+      if (disassemble)
+      {
+        printf("%12llu  --- sync ---\n",(unsigned long long)records[i].cycle);
+      }
+    }
+    size_t next=DecodeInstruction(records,i,&instruction);
+    if (next==0)
+    {
+      inSync=false;
+      i++;
+      continue;
+    }
+    instructions++;
+    if (disassemble)
+    {
+      PrintInstruction(records[i],instruction);
+    }
+    if (next<records.size() && (records[next].addr!=instruction.nextPc || records[next].cycle!=records[next-1].cycle+1))
+    {
+      inSync=false;
+    }
+    i=next;
+  }
+
+  uint64_t cycles=records.back().cycle-records.front().cycle+1;
+  printf("%zu bus cycles (%llu reads, %llu writes), cycles %llu..%llu\n",records.size(),
+    (unsigned long long)reads,(unsigned long long)(records.size()-reads),
+    (unsigned long long)records.front().cycle,(unsigned long long)records.back().cycle);
+  printf("%llu gaps, %llu cycles not recorded (%.1f%%)\n",(unsigned long long)gaps,
+    (unsigned long long)lostCycles,100.0*lostCycles/cycles);
+  printf("%llu instructions, %.2f cycles per instruction, %llu resyncs\n",(unsigned long long)instructions,
+    instructions ? (double)records.size()/instructions : 0.0,(unsigned long long)resyncs);
+
+  int pages[256];
+  for (int page=0;page<256;page++)
+  {
+    pages[page]=page;
+  }
+  std::sort(pages,pages+256,[&](int a, int b) { return pageCount[a]>pageCount[b];});
+  printf("Hot pages:\n");
+  for (int n=0;n<HOT_PAGES && pageCount[pages[n]];n++)
+  {
+    printf("  $%02X00  %10llu  %5.1f%%\n",pages[n],(unsigned long long)pageCount[pages[n]],
+      100.0*pageCount[pages[n]]/records.size());
+  }
+  printf("I/O registers:\n");
+  PrintIO("VIC",0xd000,0x40,vicReads,vicWrites);
+  PrintIO("SID",0xd400,0x20,sidReads,sidWrites);
+  PrintIO("CIA1",0xdc00,0x10,cia1Reads,cia1Writes);
+  PrintIO("CIA2",0xdd00,0x10,cia2Reads,cia2Writes);
+  if (colorRam)
+  {
+    printf("  color RAM     %10llu accesses\n",(unsigned long long)colorRam);
+  }
+  return 0;
+}
@@ -2,11 +2,28 @@
 
 CIA2::CIA2(Logging *pLogging, RpPetra *pGlue) : CIA6526(pLogging, pGlue)
 {
+  m_id=1;
+  m_registerSet[0x00]=0x03; // VIC base address to bank 0
 }
 
 CIA2::~CIA2()
 {
-  m_registerSet[0x00]=0x03; // VIC base address to bank 0
+}
+
+// Port A bits 0-1 select the VIC bank, through the data ($DD00) or the direction register ($DD02)
+void __not_in_flash_func (CIA2::WriteRegister)(uint8_t reg, uint8_t value)
+{
+  CIA6526::WriteRegister(reg,value);
+  if (reg==0x00 || reg==0x02)
+  {
+    m_pGlue->m_pVICII->SetBank(GetVicBank());
+  }
+}
+
+// Port A bits 0-1 on the pins, bits configured as input are pulled up
+uint8_t __not_in_flash_func (CIA2::GetVicBank)()
+{
+  return (m_registerSet[0x00] | ~m_registerSet[0x02]) & 0b00000011;
 }
 
 // CIA-2 is connected to NMI, not IRQ pin
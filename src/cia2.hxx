@@ -10,6 +10,8 @@ class CIA2 : public CIA6526 {
   public:
     CIA2(Logging *pLogging, RpPetra *pGlue);
     virtual ~CIA2();
+    void WriteRegister(uint8_t reg, uint8_t value);
+    uint8_t GetVicBank();
 };
 
 #endif
\ No newline at end of file
@@ -8,10 +8,24 @@
 
 #include "stdinclude.hxx"
 
+// Scheduler event handlers, context is the CIA
+static void __not_in_flash_func (OnTimerAUnderflow)(void *pContext, uint64_t cycle)
+{
+  ((CIA6526 *)pContext)->TimerUnderflow(CIA_TIMER_A,cycle);
+}
+
+static void __not_in_flash_func (OnTimerBUnderflow)(void *pContext, uint64_t cycle)
+{
+  ((CIA6526 *)pContext)->TimerUnderflow(CIA_TIMER_B,cycle);
+}
+
 CIA6526::CIA6526(Logging *pLogging, RpPetra *pGlue)
 {
     m_pLog=pLogging;
     m_pGlue=pGlue;
+    m_id=0;
+    memset(m_registerSet,0,sizeof(m_registerSet));
+    memset(m_registerSetWrite,0,sizeof(m_registerSetWrite));
 }
 
 CIA6526::~CIA6526() {}
@@ -19,7 +33,13 @@ CIA6526::~CIA6526() {}
 
 void CIA6526::Reset() 
 {
-  m_i64Clks=0;
+  Scheduler *pScheduler=m_pGlue->m_pScheduler;
+  pScheduler->Register(GetTimerEvent(CIA_TIMER_A),OnTimerAUnderflow,this);
+  pScheduler->Register(GetTimerEvent(CIA_TIMER_B),OnTimerBUnderflow,this);
+  m_timerSync[CIA_TIMER_A]=m_pGlue->GetCycle();
+  m_timerSync[CIA_TIMER_B]=m_pGlue->GetCycle();
+  ScheduleTimer(CIA_TIMER_A);
+  ScheduleTimer(CIA_TIMER_B);
 }
 
 // Default: IRQ 
@@ -28,84 +48,86 @@ void CIA6526::SignalInterrupt(bool signal)
   m_pGlue->SignalIRQ(signal);
 }
 
-void __not_in_flash_func (CIA6526::handleTimerA)()
+/**
+ * Timer counts PHI2 if started and not counting CNT (CRA/CRB bit 5) or, for timer B, 
+ * timer A underflows (CRB bit 6).
+ */
+bool __not_in_flash_func (CIA6526::IsCountingCycles)(uint8_t timer)
 {
-  // Interrupt Timer A allowed, decrease counter
-  uint16_t timer=m_registerSet[0x05]*256+m_registerSet[0x04];
-  if (timer>0 && (m_registerSet[0x0e] & 0x01)) // 0x0e bit 0 indicates start countdown
+  if (timer==CIA_TIMER_A)
   {
-    timer--;
-    m_registerSet[0x04]=timer % 256;
-    m_registerSet[0x05]=timer / 256;
-    if (timer==0)
-    {
-      // Do we need to trigger timer B?
-      if (m_registerSet[0x0f] & 0x20)
-      {
-          uint16_t timer=m_registerSet[0x07]*256+m_registerSet[0x06];
-          if (timer-->0) // timer B will fire anyway in a us...
-          {
-            m_registerSet[0x06]=timer % 256;
-            m_registerSet[0x07]=timer / 256;
-          }
-      }
-
-      if (m_registerSetWrite[0x0d] & 0x01) // IRQ timer A allowed?
-      {
-        m_registerSet[0x0d]|=0x81; // Signal IRQ, timer A
-        SignalInterrupt(true);
-        
-        if (m_registerSet[0x0e] & 0x08) // Single shot timer?
-        {
-            m_registerSet[0x0e]&=0xfe; // Indicate timer stopped
-        }
-      }
-      m_registerSet[0x04]=m_registerSetWrite[0x04];
-      m_registerSet[0x05]=m_registerSetWrite[0x05];
-    }
+    return (m_registerSet[0x0e] & 0x21)==0x01;
   }
+  return (m_registerSet[0x0f] & 0x61)==0x01;
 }
 
-void __not_in_flash_func (CIA6526::handleTimerB)()
+// Brings the counters of the running timers up to the cycle given
+void __not_in_flash_func (CIA6526::SyncTimers)(uint64_t now)
 {
-  // Interrupt Timer B allowed, decrease counter
-  uint16_t timer=m_registerSet[0x07]*256+m_registerSet[0x06];
-  if (timer>0 && (m_registerSet[0x0e] & 0x01)) // 0x0e bit 0 indicates start countdown
+  for (uint8_t timer=CIA_TIMER_A;timer<=CIA_TIMER_B;timer++)
   {
-    timer--;
-    m_registerSet[0x06]=timer % 256;
-    m_registerSet[0x07]=timer / 256;
-    if (timer==0)
+    if (IsCountingCycles(timer))
     {
-      if (m_registerSetWrite[0x0d] & 0x02) // IRQ timer B allowed?
-      {
-        m_registerSet[0x0d]|=0x82; // Signal IRQ, timer B
-        SignalInterrupt(true);
-
-        if (m_registerSet[0x0f] & 0x08) // Single shot timer?
-        {
-            m_registerSet[0x0f]&=0xfe; // Indicate timer stopped
-        }
-      }
-      m_registerSet[0x06]=m_registerSetWrite[0x06];
-      m_registerSet[0x07]=m_registerSetWrite[0x07];
+      SetCounter(timer,GetCounter(timer)-(uint16_t)(now-m_timerSync[timer]));
     }
+    m_timerSync[timer]=now;
+  }
+}
+
+// The counter runs down to 0 and underflows one cycle later, i.e. the period is latch+1
+void __not_in_flash_func (CIA6526::ScheduleTimer)(uint8_t timer)
+{
+  if (IsCountingCycles(timer))
+  {
+    m_pGlue->m_pScheduler->Schedule(GetTimerEvent(timer),m_timerSync[timer]+GetCounter(timer)+1);
+  }
+  else
+  {
+    m_pGlue->m_pScheduler->Cancel(GetTimerEvent(timer));
   }
 }
 
-void __not_in_flash_func (CIA6526::Clk)() 
+void __not_in_flash_func (CIA6526::TimerUnderflow)(uint8_t timer, uint64_t cycle)
 {
-  m_i64Clks++;
+  uint8_t cr=0x0e + timer;
+  uint8_t icrBit=(timer==CIA_TIMER_A) ? 0x01 : 0x02;
+
+  SetCounter(timer,GetLatch(timer));
+  m_timerSync[timer]=cycle;
   
-  if (m_registerSet[0x0e] & 0x01) // Start timer set?
-    handleTimerA();
+  m_registerSet[0x0d]|=icrBit; // Data bit is set even if the interrupt is masked
+  if (m_registerSetWrite[0x0d] & icrBit) // IRQ timer allowed?
+  {
+    m_registerSet[0x0d]|=0x80;
+    SignalInterrupt(true);
+  }
+  if (m_registerSet[cr] & 0x08) // Single shot timer?
+  {
+    m_registerSet[cr]&=0xfe; // Indicate timer stopped
+  }
 
-  if (m_registerSet[0x0f] & 0x01) // Start timer set?
-    handleTimerB();
+  // Do we need to trigger timer B?
+  if (timer==CIA_TIMER_A && (m_registerSet[0x0f] & 0x41)==0x41)
+  {
+    uint16_t counterB=GetCounter(CIA_TIMER_B);
+    if (counterB==0)
+    {
+      TimerUnderflow(CIA_TIMER_B,cycle);
+    }
+    else
+    {
+      SetCounter(CIA_TIMER_B,counterB-1);
+    }
+  }
+  ScheduleTimer(timer);
 }
 
 uint8_t CIA6526::ReadRegister(uint8_t reg) 
 {
+  if (reg>=0x04 && reg<=0x07)
+  {
+    SyncTimers(m_pGlue->GetCycle());
+  }
   uint8_t ret=m_registerSet[reg];
   if (reg==0x0d)
   {
@@ -176,20 +198,12 @@ void __not_in_flash_func (CIA6526::WriteRegister)(uint8_t reg, uint8_t value)
     case 0x07:
       // In case high byte timer a/b is set, also high byte of timer is set in case timer is stopped
       m_registerSetWrite[reg]=value; // latch
-      if (reg==0x05) // timer A
+      if ((m_registerSet[0x0e + (reg-0x05)/2] & 0x01)==0) // timer stopped?
       {
-        if ((m_registerSet[0x0e] &  0x01)==0) // timer A stopped?
-        {
-          m_registerSet[reg-1]=m_registerSetWrite[reg-1];        
-        }
-      }
-      else // timer B
-      {
-        if ((m_registerSet[0x0f] &  0x01)==0) // timer b stopped?
-        {
-          m_registerSet[reg-1]=m_registerSetWrite[reg-1];        
-        }
+        m_registerSet[reg-1]=m_registerSetWrite[reg-1];        
+        m_registerSet[reg]=value;
       }
+    break;
     case 0x04:
     case 0x06:
       m_registerSetWrite[reg]=value;        
@@ -197,20 +211,13 @@ void __not_in_flash_func (CIA6526::WriteRegister)(uint8_t reg, uint8_t value)
 
     case 0x0e:
     case 0x0f:
-      if (value & 10) // Load latch into timer (strobe)?
+      SyncTimers(m_pGlue->GetCycle()); // Count the cycles passed in the old mode
+      if (value & 0x10) // Load latch into timer (strobe)?
       {
-        if (reg==0x0e)
-        {
-          m_registerSet[0x04]=m_registerSetWrite[0x04];
-          m_registerSet[0x05]=m_registerSetWrite[0x05];
-        }
-        else
-        {
-          m_registerSet[0x06]=m_registerSetWrite[0x06];
-          m_registerSet[0x07]=m_registerSetWrite[0x07];
-        }
+        SetCounter(reg-0x0e,GetLatch(reg-0x0e));
       }
       m_registerSet[reg]=(value & 0xef); // Bit 4 will always read 0
+      ScheduleTimer(reg-0x0e);
     break;
 
     default:
@@ -1,29 +1,39 @@
-
 #ifndef CIA6526_HXX_
 #define CIA6526_HXX_
 
 class RpPetra;
 
+#define CIA_TIMER_A 0
+#define CIA_TIMER_B 1
+
 class CIA6526 {
   
   protected:  
     Logging *m_pLog;
-    uint64_t m_i64Clks;
     uint8_t m_registerSet[0x10];    
     uint8_t m_registerSetWrite[0x10];
     uint8_t m_id;
     RpPetra *m_pGlue;
+    // Timers are not clocked, the counters in m_registerSet are brought up to date
+    // on access and the underflow is a scheduler event.
+    uint64_t m_timerSync[2];
+
+    inline uint16_t GetCounter(uint8_t timer) { return m_registerSet[0x05+timer*2]*256+m_registerSet[0x04+timer*2];};
+    inline void SetCounter(uint8_t timer, uint16_t value) { m_registerSet[0x04+timer*2]=value % 256; m_registerSet[0x05+timer*2]=value / 256;};
+    inline uint16_t GetLatch(uint8_t timer) { return m_registerSetWrite[0x05+timer*2]*256+m_registerSetWrite[0x04+timer*2];};
+    inline EventId GetTimerEvent(uint8_t timer) { return (EventId)(EventCia1TimerA+m_id*2+timer);};
+    bool IsCountingCycles(uint8_t timer);
+    void SyncTimers(uint64_t now);
+    void ScheduleTimer(uint8_t timer);
   
   public:
     CIA6526(Logging *pLogging, RpPetra *pGlue);
     virtual ~CIA6526();
     void Reset();
-    void Clk();
     virtual void WriteRegister(uint8_t reg, uint8_t value);
     virtual uint8_t ReadRegister(uint8_t reg);
-    virtual void handleTimerA();
-    virtual void handleTimerB();
+    void TimerUnderflow(uint8_t timer, uint64_t cycle);
     virtual void SignalInterrupt(bool signal); // true- yes, false-no
 };
 
-#endif
\ No newline at end of file
+#endif
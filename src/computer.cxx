@@ -44,22 +44,44 @@ Computer::Computer(Logging *pLogging)
     m_pLogging=pLogging;
     m_systemState.cpuState.isA0A15SetToOutput=true;
     m_totalCyles=0;
+    m_usbPending=false;
 }
 
 Computer::~Computer()
 {
 }
 
+// Scheduler event, keyboard and joysticks. The poll waits for a badline or sprite DMA (Run),
+// unless there was none since the last event (display off).
+static void PollUsb(void *pContext, uint64_t cycle)
+{
+  Computer *pComputer=(Computer *)pContext;
+  if (pComputer->m_usbPending)
+  {
+    tuh_task();
+  }
+  pComputer->m_usbPending=true;
+}
+
 int __not_in_flash_func (Computer::Run)()
 {
   Init();
   tuh_task();
+  Scheduler *pScheduler=m_pGlue->m_pScheduler;
+  pScheduler->Register(EventUsbPoll,PollUsb,this);
+  pScheduler->Schedule(EventUsbPoll,m_totalCyles+USB_POLL_CYCLES,USB_POLL_CYCLES);
   do {
-    if (m_totalCyles%20000==0)
+    // Single compare per bus cycle, everything else happens in the event handlers
+    if (m_totalCyles>=pScheduler->GetNextEventCycle())
     {
-        tuh_task();
+      pScheduler->Dispatch(m_totalCyles);
+    }
+    if (!m_pGlue->Clk(&m_systemState,m_totalCyles) && m_usbPending)
+    {
+      // The VIC has the bus, no 65C02 cycle is waiting for a reply
+      m_usbPending=false;
+      tuh_task();
     }
-    m_pGlue->Clk(&m_systemState,m_totalCyles);
     m_totalCyles++;
   } while (1);
   return (0);
@@ -84,8 +106,10 @@ int Computer::Init()
 */
 void process_kbd_report (hid_keyboard_report_t const* report)
 { 
+  static bool wasWarpKey=false; // reports repeat while a key is held
   if (report!=nullptr) 
   {
+    bool warpKey=false;
     _pGlue->m_pKeyboard->OnKeyReleased(0,0);
 
     if (report->modifier==0x02 || report->modifier==0x20)
@@ -108,12 +132,21 @@ void process_kbd_report (hid_keyboard_report_t const* report)
         _pGlue->SignalNMI(false);
         _pGlue->SignalNMI(true);
       }
+      else if (report->keycode[i]==0x45) // F12 => warp on/off
+      {
+        warpKey=true;
+        if (!wasWarpKey)
+        {
+          _pGlue->m_pGovernor->SetWarp(!_pGlue->m_pGovernor->IsWarp());
+        }
+      }
       else if (report->keycode[i]<sizeof(keyboardMapRow) && keyboardMapRow[report->keycode[i]]!=0)
       {
         _pGlue->m_pKeyboard->OnKeyPressed(keyboardMapRow[report->keycode[i]],keyboardMapCol[report->keycode[i]]); 
       }
       i++;
     }
+    wasWarpKey=warpKey;
   }
 }
 
@@ -1,6 +1,8 @@
 #ifndef _COMPUTER_HXX
 #define _COMPUTER_HXX
 
+#define USB_POLL_CYCLES 20000
+
 class RpPetra;
 extern RpPetra *_pGlue;
 
@@ -27,6 +29,7 @@ class Computer {
     RpPetra *m_pGlue;
 
     int m_WaitCycles;
+    bool m_usbPending; // USB is polled in the next cycle the VIC has the bus
 
     uint64_t inline GetTotalCycles() { return m_totalCyles;}
 
@@ -0,0 +1,53 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * The bus between RpPetra and the CPU. There are two backends with the same methods,
+ * selected at compile time so the calls in RpPetra::Clk() stay inline:
+ * 
+ *  GpioBus (gpioBus.hxx)  physical 65C02 on GPIO0-11 (bit-banged or PIO bus sequencer)
+ *  HostBus (hostBus.hxx)  software CPU (HostCpu) for the Linux host build (_HOST)
+ * 
+ *  void Init();                           bus to idle, IRQ and NMI released
+ *  void ResetCPU();                       RESET sequence, afterwards bus cycles are valid
+ *  void NextCycle(CPUSTATE *pCpuState);   next bus cycle (PHI2 high): address, R/W, data
+ *  void WriteDataBus(uint8_t byte);       answers a read cycle
+ *  void SignalIRQ(bool enable);           true: IRQB low
+ *  void SignalNMI(bool enable);           true: NMIB low
+*/
+
+#ifndef _CPU_BUS_HXX
+#define _CPU_BUS_HXX
+
+typedef struct 
+{
+  bool  isRisingEdge;
+  uint16_t a0a15;
+  uint8_t d0d7;
+  bool readNotWrite;
+  bool isA0A15SetToOutput;
+} CPUSTATE;
+
+typedef struct 
+{
+  CPUSTATE cpuState;
+} SYSTEMSTATE;
+
+// Layout of a bus cycle word pushed by the state machine (see busSequencer.pio), also
+// taken by HostBus from BusSequencerModel
+constexpr uint32_t busWordShiftA0A7 = 16;
+constexpr uint32_t busWordShiftA8A15 = 8;
+constexpr uint32_t busWordMaskRW = 1 << (busWordShiftA0A7+RW);
+
+constexpr uint16_t BusWordAddress(uint32_t busWord) { return ((busWord >> busWordShiftA0A7) & 0xff) | (busWord & 0xff00); }
+constexpr bool BusWordIsRead(uint32_t busWord) { return (busWord & busWordMaskRW)!=0; }
+constexpr uint8_t BusWordData(uint32_t busWord) { return busWord & 0xff; }
+
+#ifdef _HOST
+class HostBus;
+typedef HostBus CpuBus;
+#else
+class GpioBus;
+typedef GpioBus CpuBus;
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+Governor::Governor(Logging *pLogging, Scheduler *pScheduler)
+{
+  m_pLog=pLogging;
+  m_pScheduler=pScheduler;
+  m_clockHz=PAL_CLOCK_HZ;
+  m_warp=false;
+  m_achievedHz=0;
+  m_maxHz=0;
+  m_pScheduler->Register(EventGovernor,OnBatch,this);
+  Anchor(0,time_us_64());
+}
+
+Governor::~Governor()
+{
+}
+
+void Governor::Anchor(uint64_t cycle, uint64_t now)
+{
+  m_startCycle=cycle;
+  m_startUs=now;
+  m_waitUs=0;
+  m_windowCycle=cycle;
+  m_windowUs=now;
+  m_windowWaitUs=0;
+}
+
+void Governor::Reset(uint64_t cycle)
+{
+  Anchor(cycle,time_us_64());
+  m_pScheduler->Schedule(EventGovernor,cycle+GOVERNOR_BATCH_CYCLES,GOVERNOR_BATCH_CYCLES);
+}
+
+void Governor::SetClock(uint32_t clockHz)
+{
+  m_clockHz=clockHz;
+  Anchor(m_startCycle,time_us_64());
+}
+
+void Governor::SetWarp(bool warp)
+{
+  if (warp!=m_warp)
+  {
+    m_warp=warp;
+    m_pLog->LogInfo({warp ? "Warp on" : "Warp off"});
+  }
+}
+
+void __not_in_flash_func(Governor::OnBatch)(void *pContext, uint64_t cycle)
+{
+  ((Governor *)pContext)->Pace(cycle);
+}
+
+void __not_in_flash_func(Governor::Pace)(uint64_t cycle)
+{
+  uint64_t now=time_us_64();
+  if (m_warp)
+  {
+    m_startCycle=cycle;
+    m_startUs=now;
+  }
+  else
+  {
+    uint64_t target=m_startUs+(cycle-m_startCycle)*1000000/m_clockHz;
+    if (now<target)
+    {
+      sleep_us(target-now);
+      uint64_t woken=time_us_64();
+      m_waitUs+=woken-now;
+      now=woken;
+    }
+    else if (now-target>GOVERNOR_MAX_LAG_US)
+    {
+      // Stalled (e.g. USB enumeration), continue from here instead of running fast
+      m_startCycle=cycle;
+      m_startUs=now;
+    }
+  }
+
+  uint64_t elapsed=now-m_windowUs;
+  if (elapsed>=GOVERNOR_WINDOW_US)
+  {
+    uint64_t cycles=cycle-m_windowCycle;
+    uint64_t busy=elapsed-(m_waitUs-m_windowWaitUs);
+    m_achievedHz=cycles*1000000/elapsed;
+    m_maxHz=busy ? cycles*1000000/busy : 0;
+    m_windowCycle=cycle;
+    m_windowUs=now;
+    m_windowWaitUs=m_waitUs;
+  }
+}
@@ -0,0 +1,54 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * PHI2 pacing. Without it the bus runs as fast as the main loop goes (see the timings
+ * at the top of rpPetra.cxx). Every GOVERNOR_BATCH_CYCLES a scheduler event compares the
+ * cycle count with time_us_64() and waits until the average rate is exactly the PAL
+ * or NTSC clock. Warp switches the waiting off, e.g. while loading.
+*/
+
+#ifndef _GOVERNOR_HXX
+#define _GOVERNOR_HXX
+
+#define PAL_CLOCK_HZ 985248
+#define NTSC_CLOCK_HZ 1022727
+#define GOVERNOR_BATCH_CYCLES 1000   // ~1ms
+#define GOVERNOR_MAX_LAG_US 20000    // more behind than this: do not try to catch up
+#define GOVERNOR_WINDOW_US 1000000   // rate counters are updated once per second
+
+class Governor {
+
+  private:
+    Logging *m_pLog;
+    Scheduler *m_pScheduler;
+    uint32_t m_clockHz;
+    bool m_warp;
+    // Cycle m_startCycle was at m_startUs
+    uint64_t m_startCycle;
+    uint64_t m_startUs;
+    // Counters
+    uint64_t m_waitUs;
+    uint64_t m_windowCycle;
+    uint64_t m_windowUs;
+    uint64_t m_windowWaitUs;
+    uint32_t m_achievedHz;
+    uint32_t m_maxHz;
+
+    void Anchor(uint64_t cycle, uint64_t now);
+    void Pace(uint64_t cycle);
+    static void OnBatch(void *pContext, uint64_t cycle);
+
+  public:
+    Governor(Logging *pLogging, Scheduler *pScheduler);
+    virtual ~Governor();
+    void Reset(uint64_t cycle);
+    void SetClock(uint32_t clockHz);
+    void SetWarp(bool warp);
+    inline bool IsWarp() { return m_warp;};
+    inline uint32_t GetClock() { return m_clockHz;};
+    // Bus rate of the last second, and the rate it would have had without waiting
+    inline uint32_t GetAchievedHz() { return m_achievedHz;};
+    inline uint32_t GetMaxHz() { return m_maxHz;};
+};
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+GpioBus::GpioBus(Logging *pLogging)
+{
+  m_pLog=pLogging;
+#ifdef _PIO_BUS
+  m_pBusSequencer=new BusSequencer(pLogging);
+#endif
+}
+
+GpioBus::~GpioBus()
+{
+}
+
+void GpioBus::Init()
+{
+#ifdef _PIO_BUS
+  m_pBusSequencer->Stop();
+#endif
+  // Activate RP2040 pins used for the CPU communication
+  gpio_init_mask(pioMask_CPU);   
+  gpio_set_dir(CLK,true); // CLK is always an output signal
+  gpio_set_dir(RESET,true); // RESET is always an output signal
+  gpio_set_dir(IRQ,true); // IRQ is always an output signal
+  gpio_set_dir(NMI,true); // NMI is always an output signal
+  gpio_set_dir(RW,false);  // RW pin is always input from 6502
+  gpio_set_dir_out_masked(pioMaskOE_U5_U6_U7);  // Set OE pins to output 
+  gpio_set_dir_in_masked(pioMaskData_U5_U6_U7); // Switch all pio pins from transceiver data lines to input
+  SignalIRQ(false);
+  SignalNMI(false);
+  DisableBus();
+}
+
+// Reset logic for 65C02 
+void GpioBus::ResetCPU()
+{
+  // According to the WDC databook, we need to keep RESB low for at least two
+  // cycles. However, for the 65C02 silicon used in the neo6502 this is not necessary. 
+  // A little delay would do without requiring any PHI2 (CLK).
+  gpio_put(RESET, LOW); // RESET is low active so reset is active now
+  ClockCPU(2);
+  gpio_put(RESET, HIGH);
+  // We now have to run six (in fact 7) clock cycles before any data from CPU is valid. Source: WDC 65C02 databook.
+  ClockCPU(7);
+#ifdef _PIO_BUS
+  m_pBusSequencer->Start();
+#endif
+}
+
+// Triggers the PHI2 the number of times specified gracefully. It looks like the
+// 65C02 requires some time during RESET not relying to CLK.
+void GpioBus::ClockCPU(int counter)
+{
+  for (int i=0;i<counter;i++)
+  {
+    PHI2(LOW);
+    sleep_ms(10);
+    PHI2(HIGH);
+    sleep_ms(10);
+  }
+}
+
+// Note: According to the WDC the IRQB low level should be held until the interrupt handler clears 
+// the interrupt request source.
+void GpioBus::SignalIRQ(bool enable)
+{
+  if (enable) gpio_put(IRQ, LOW); // IRQ is low active so reset is active now
+  else gpio_put(IRQ, HIGH); // IRQ is low active so reset is active now
+}
+
+// WDC: A negative transition on the Non-Maskable Interrupt (NMIB) input initiates an interrupt sequence after the
+// current instruction is completed
+void GpioBus::SignalNMI(bool enable)
+{
+  if (enable) gpio_put(NMI, LOW); // IRQ is low active so reset is active now
+  else gpio_put(NMI, HIGH); // IRQ is low active so reset is active now
+}
@@ -0,0 +1,96 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Bus backend for the physical 65C02 (see cpuBus.hxx). A0-A15 and D0-D7 are
+ * multiplexed on GPIO0-7 by the 74LVC245 transceivers U5, U6 and U7. With _PIO_BUS
+ * PHI2 and the multiplexing are done by the BusSequencer, otherwise bit-banged.
+*/
+
+#ifndef _GPIO_BUS_HXX
+#define _GPIO_BUS_HXX
+
+/** Mask for pins 0-11, 21 and 28 
+ *  A0-A15 multiplexed by 3x 3-state octal bus transceiver 74LVC245APW (pins 0-7)
+ *  Multiplexing pins 8,9,10 for output enable signal(OE) for U5, U6 and U7 (high= Z-state, low=enable)
+ *  Pin 11 is used for data direction of U7 when OE=low. HIGH=Read from bus, LOW= Write to bus
+ *  PIN 25,26,27 are for IRQ, RESET, NMI
+ */
+constexpr uint32_t pioMask_CPU = 0b00001110001000000000111111111111; 
+constexpr uint32_t pioMaskData_U5_U6_U7 = 0b011111111; 
+constexpr uint32_t pioMaskData_U5_U6_U7_RW = 0b100011111111; 
+constexpr uint32_t pioMaskOE_U5_U6_U7 =  0b0000000000000000000011100000000; // Modify PIO PINs 8,9 and 10 (74LVC245APW U5, U6 and U7) only
+
+constexpr uint32_t enableU5Only =  0b0000000000000000000011000000000; // set OE (active low) to low on U5 (PIO 8, A0-A7), others to high 
+constexpr uint32_t enableU6Only =  0b0000000000000000000010100000000; // set OE (active low) to low on U6 (PIO 9, A8-A15), others to high  
+constexpr uint32_t enableU7Only =  0b0000000000000000000001100000000; // set OE (active low) to low on U7 (PIO 10, D0-D7), others to high 
+constexpr uint32_t disableU5U6U7 = 0b0000000000000000000011100000000; // set OE (active low) to high for Z-state of U5, U6 and U7
+
+class GpioBus {
+
+  private:
+    Logging *m_pLog;
+#ifdef _PIO_BUS
+    BusSequencer *m_pBusSequencer;
+#endif
+
+    inline void Enable_U5_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU5Only); };  
+    inline void Enable_U6_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU6Only); };  
+    inline void Enable_U7_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU7Only); };  
+    inline void DisableBus()     { gpio_put_masked(pioMaskOE_U5_U6_U7, disableU5U6U7);}
+    inline void PHI2(bool isRisingEdge) { gpio_put(CLK,isRisingEdge);}
+    void ClockCPU(int counter);
+
+  public:
+    GpioBus(Logging *pLogging);
+    virtual ~GpioBus();
+    void Init();
+    void ResetCPU();
+    void SignalIRQ(bool enable);
+    void SignalNMI(bool enable);
+
+    inline void NextCycle(CPUSTATE *pCpuState)
+    {
+#ifdef _PIO_BUS
+      // PHI2 and the transceivers are driven by the bus sequencer
+      uint32_t busWord=m_pBusSequencer->NextCycle();
+      pCpuState->a0a15=BusWordAddress(busWord);
+      pCpuState->readNotWrite=BusWordIsRead(busWord);
+      pCpuState->d0d7=BusWordData(busWord);
+#else
+      PHI2(LOW);
+      gpio_set_dir_in_masked(pioMaskData_U5_U6_U7); // set the datalines to input (seen from RP2040 side)   
+      DELAY_FACTOR_PHI2_LOW();
+      PHI2(HIGH);
+      // read A0-7
+      Enable_U5_only();
+      DELAY_FACTOR_TRANSCEIVER()
+      pCpuState->a0a15 = (gpio_get_all() & pioMaskData_U5_U6_U7_RW);
+      pCpuState->readNotWrite=pCpuState->a0a15 & 0x800;
+      // read A8-15
+      Enable_U6_only();
+      DELAY_FACTOR_TRANSCEIVER();
+      pCpuState->a0a15 &= 0xf7ff;
+      pCpuState->a0a15 |= (gpio_get_all() & pioMaskData_U5_U6_U7) << 8;
+      // In case 65C02 indicates a write, read databus as well.
+      if (!pCpuState->readNotWrite)
+      {
+          Enable_U7_only();
+          DELAY_FACTOR_TRANSCEIVER();
+          pCpuState->d0d7=(gpio_get_all() & pioMaskData_U5_U6_U7);    
+      } 
+#endif
+    };
+
+    inline void WriteDataBus(uint8_t byte)
+    {
+#ifdef _PIO_BUS
+      m_pBusSequencer->Reply(byte);
+#else
+      gpio_set_dir_out_masked(pioMaskData_U5_U6_U7); // set the datalines to output (seen from RP2040 side)
+      gpio_put_masked(pioMaskData_U5_U6_U7,(uint32_t)byte);
+      Enable_U7_only();
+#endif
+    };
+};
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+HostBus::HostBus(Logging *pLogging)
+{
+  m_pLog=pLogging;
+  m_pCpu=nullptr;
+  m_pSequencer=nullptr;
+  m_replyDelay=0;
+  m_reply=0;
+  m_irq=false;
+  m_nmi=false;
+}
+
+HostBus::~HostBus()
+{
+}
+
+// The CPU starts with a RESET and the current IRQ/NMI lines
+void HostBus::Attach(HostCpu *pCpu)
+{
+  m_pCpu=pCpu;
+  if (m_pCpu!=nullptr)
+  {
+    ResetCPU();
+    m_pCpu->SetIRQ(m_irq);
+    m_pCpu->SetNMI(m_nmi);
+  }
+}
+
+/**
+ * The CPU (attached before) is clocked by the state machine model from now on, nullptr
+ * detaches it again. The model starts over with every RESET, as BusSequencer::Start() does.
+ */
+void HostBus::AttachSequencer(BusSequencerModel *pSequencer, uint8_t replyDelay)
+{
+  m_pSequencer=pSequencer;
+  m_replyDelay=replyDelay;
+  ResetCPU();
+}
+
+void HostBus::Init()
+{
+  SignalIRQ(false);
+  SignalNMI(false);
+}
+
+void HostBus::ResetCPU()
+{
+  if (m_pCpu!=nullptr)
+  {
+    m_pCpu->Reset();
+  }
+  if (m_pSequencer!=nullptr)
+  {
+    m_pSequencer->Reset();
+  }
+}
+
+void HostBus::SignalIRQ(bool enable)
+{
+  m_irq=enable;
+  if (m_pCpu!=nullptr)
+  {
+    m_pCpu->SetIRQ(enable);
+  }
+}
+
+void HostBus::SignalNMI(bool enable)
+{
+  m_nmi=enable;
+  if (m_pCpu!=nullptr)
+  {
+    m_pCpu->SetNMI(enable);
+  }
+}
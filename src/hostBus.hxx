@@ -0,0 +1,81 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Bus backend for the Linux host build (see cpuBus.hxx). The bus cycles come from a
+ * software CPU instead of GPIO0-11. Without a CPU attached every cycle is a read of
+ * $FFFF, which is enough to profile the glue, VIC and CIA stack on its own. With a
+ * BusSequencerModel attached the CPU runs behind the modelled PIO state machine and the
+ * cycles are taken as packed bus words, like GpioBus does with _PIO_BUS.
+*/
+
+#ifndef _HOST_BUS_HXX
+#define _HOST_BUS_HXX
+
+class HostBus {
+
+  private:
+    Logging *m_pLog;
+    HostCpu *m_pCpu;
+    BusSequencerModel *m_pSequencer;
+    uint8_t m_replyDelay; // PIO clocks Clk() takes to answer a read cycle
+    uint8_t m_reply;
+    bool m_irq;
+    bool m_nmi;
+
+  public:
+    HostBus(Logging *pLogging);
+    virtual ~HostBus();
+    void Attach(HostCpu *pCpu);
+    void AttachSequencer(BusSequencerModel *pSequencer, uint8_t replyDelay);
+    void Init();
+    void ResetCPU();
+    void SignalIRQ(bool enable);
+    void SignalNMI(bool enable);
+
+    // Last byte a read cycle was answered with
+    inline uint8_t GetReply() { return m_reply;};
+
+    inline void NextCycle(CPUSTATE *pCpuState)
+    {
+      if (m_pSequencer!=nullptr)
+      {
+        uint32_t busWord;
+        if (!m_pSequencer->GetBlocking(&busWord))
+        {
+          // A read cycle has not been answered, pio_sm_get_blocking() would hang on the board
+          busWord=(0xffu << busWordShiftA0A7) | 0xff00 | busWordMaskRW;
+        }
+        pCpuState->a0a15=BusWordAddress(busWord);
+        pCpuState->readNotWrite=BusWordIsRead(busWord);
+        pCpuState->d0d7=BusWordData(busWord);
+      }
+      else if (m_pCpu!=nullptr)
+      {
+        m_pCpu->NextCycle(&pCpuState->a0a15,&pCpuState->readNotWrite,&pCpuState->d0d7);
+      }
+      else
+      {
+        pCpuState->a0a15=0xffff;
+        pCpuState->readNotWrite=true;
+      }
+    };
+
+    inline void WriteDataBus(uint8_t byte)
+    {
+      m_reply=byte;
+      if (m_pSequencer!=nullptr)
+      {
+        for (int clock=0;clock<m_replyDelay;clock++)
+        {
+          m_pSequencer->Step();
+        }
+        m_pSequencer->Put(byte);
+      }
+      else if (m_pCpu!=nullptr)
+      {
+        m_pCpu->Latch(byte);
+      }
+    };
+};
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Software stand-in for the physical 65C02, one bus cycle per NextCycle() call. It is
+ * driven by the host bus backend (hostBus.hxx), directly or through BusSequencerModel
+ * (HostBus::AttachSequencer()).
+*/
+
+#ifndef _HOST_CPU_HXX
+#define _HOST_CPU_HXX
+
+class HostCpu {
+
+  public:
+    virtual ~HostCpu() {};
+    // RESB has been pulled low and released again
+    virtual void Reset()=0;
+    // IRQB/NMIB, true: line pulled low
+    virtual void SetIRQ(bool enable)=0;
+    virtual void SetNMI(bool enable)=0;
+    // PHI2 has fallen: a read cycle latches the data bus.
+    virtual void Latch(uint8_t data)=0;
+    // Address, R/W and (write cycle) data for the next bus cycle.
+    virtual void NextCycle(uint16_t *pAddr, bool *pReadNotWrite, uint8_t *pData)=0;
+};
+
+#endif
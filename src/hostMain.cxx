@@ -0,0 +1,918 @@
+/**
+ * Linux host build of the glue, VIC, CIA and SID stack (cmake -DHOST_BUILD=ON).
+ * There is no DVI, USB or GPIO, RpPetra talks to the software 6510 (RP65C02) through HostBus.
+ * 
+ * Usage: computer_host [-t trace.bin] [-p pal|ntsc] [cycles]
+ * Runs the given number of bus cycles (default 10 seconds of PAL time) as fast as
+ * possible and reports the emulated bus rate. -p paces the bus like the board (Governor).
+ * 
+ * Usage: computer_host [-t trace.bin] [-p pal|ntsc] -b
+ * Headless benchmark: boots the KERNAL until READY. shows up on the screen, then runs
+ * the loop from the top of rpPetra.cxx (relocated to $C000) until it writes $D020.
+ * 
+ * Usage: computer_host -r
+ * VIC renderer benchmark: renders random screens in all display modes with VIC6569::Render()
+ * and with the former bit by bit code, checks both frame buffers are identical and
+ * reports ns per line. Then compares both for every multicolor colour combination.
+ * 
+ * Usage: computer_host -q
+ * PIO bus sequencer check: runs the 6510 through BusSequencerModel into RpPetra::Clk(),
+ * checks the bus words, FIFO stalls and transceiver contention and reports ns per cycle.
+ * 
+ * Usage: computer_host -a trace.bin
+ * Address decoder benchmark: replays the bus cycles of a -t trace through the former if/else
+ * decoder and through the page tables of RpPetra::Clk() and reports ns per cycle.
+ * 
+ * Usage: computer_host -i
+ * VIC interrupt check: a raster IRQ handler acknowledges $D019 with STA, ASL and INC, then
+ * enables $D01A again, checks there is one IRQ per frame and $D019 reads 0 afterwards.
+ * 
+ * -t trace.bin records every bus cycle (see busTrace.hxx),
+ * busTraceDecode prints it.
+ * 
+ * Written by Bernd Krekeler, Herne, Germany
+*/
+
+#include "stdinclude.hxx"
+
+#define DEFAULT_HOST_CYCLES (PAL_CLOCK_HZ*10ull)
+#define BOOT_TIMEOUT_CYCLES (PAL_CLOCK_HZ*10ull)
+#define BENCHMARK_TIMEOUT_CYCLES (PAL_CLOCK_HZ*200ull)
+#define BENCHMARK_ADDR 0xc000
+#define READY_POLL_CYCLES 20000
+#define RENDER_FRAMES 500
+#define SEQUENCER_CYCLES 2000000
+#define DECODER_CYCLES 20000000 // a shorter trace is replayed again until there are as many
+#define SEQUENCER_REPLY_DELAY 6 // PIO clocks Clk() takes to answer a read cycle in the second -q run
+#define IRQ_FRAMES 50
+#define IRQ_HANDLER_ADDR 0xc100
+#define IRQ_RESET_CYCLES 7
+#define IRQ_RESULT_ADDR 0x340 // $D019 after the acknowledges ORed, then the IRQ count (16 bit)
+
+// sei, then the loop from rpPetra.cxx with jmp loop1 pointing to $C005
+static const uint8_t benchmark[]={0x78,0xA9,0x00,0xAA,0xA8,0xE8,0xD0,0xFD,0xC8,0xD0,0xFA,0xAA,0xE8,0x8A,0xC9,0xFF,0xD0,0xF3,0x8D,0x20,0xD0,0x4C,0x05,0xC0};
+// sei, RAM at $E000 with I/O, CIA1 interrupts off, raster IRQ at line $80, acknowledges the match
+// of line 0 latched since RESET, cli, jmp *
+static const uint8_t irqSetup[]={0x78,0xA9,0x2F,0x85,0x00,0xA9,0x35,0x85,0x01,0xA9,0x7F,0x8D,0x0D,0xDC,0xAD,0x0D,0xDC,
+  0xA9,0x1B,0x8D,0x11,0xD0,0xA9,0x80,0x8D,0x12,0xD0,0xA9,0x01,0x8D,0x19,0xD0,0x8D,0x1A,0xD0,0x58,0x4C,0x24,0xC0};
+// The handler after the acknowledge: ORs $D019 into $0340, writes $D01A again, ORs $D019 again,
+// counts the IRQ in $0341/$0342 and returns
+static const uint8_t irqHandlerTail[]={0xAD,0x19,0xD0,0x0D,0x40,0x03,0x8D,0x40,0x03,0xA9,0x01,0x8D,0x1A,0xD0,
+  0xAD,0x19,0xD0,0x0D,0x40,0x03,0x8D,0x40,0x03,0xEE,0x41,0x03,0xD0,0x03,0xEE,0x42,0x03,0x40};
+struct IrqAcknowledge
+{
+  const char *pName;
+  uint8_t length;
+  uint8_t code[6];
+};
+static const IrqAcknowledge irqAcknowledges[]={
+  {"lda/sta",6,{0xAD,0x19,0xD0,0x8D,0x19,0xD0}}, // lda $d019, sta $d019
+  {"asl",3,{0x0E,0x19,0xD0}},                    // asl $d019, the dummy write acknowledges
+  {"inc",3,{0xEE,0x19,0xD0}}};                   // inc $d019, the same
+// "READY." in screen codes
+static const uint8_t ready[]={0x12,0x05,0x01,0x04,0x19,0x2e};
+
+static uint64_t totalCycles=0;
+static FILE *pTraceFile=nullptr;
+
+// Scheduler event, empties the bus trace ring into the file
+static void WriteTrace(void *pContext, uint64_t cycle)
+{
+  BusTrace *pTrace=(BusTrace *)pContext;
+  static uint8_t buffer[BUS_TRACE_ENTRIES*BUS_TRACE_MAX_RECORD];
+  size_t size;
+  while ((size=pTrace->Encode(buffer,sizeof(buffer)))>0)
+  {
+    fwrite(buffer,1,size,pTraceFile);
+  }
+}
+
+// One bus cycle, true if the CPU wrote to addr
+static inline bool Step(RpPetra *pGlue, SYSTEMSTATE *pSystemState, uint16_t addr)
+{
+  Scheduler *pScheduler=pGlue->m_pScheduler;
+  if (totalCycles>=pScheduler->GetNextEventCycle())
+  {
+    pScheduler->Dispatch(totalCycles);
+  }
+  pGlue->Clk(pSystemState,totalCycles);
+  totalCycles++;
+  return !pSystemState->cpuState.readNotWrite && pSystemState->cpuState.a0a15==addr;
+}
+
+static bool IsReady(RpPetra *pGlue)
+{
+  const uint8_t *pScreen=pGlue->m_pRAM+0x400;
+  for (int i=0;i<1000-(int)sizeof(ready);i++)
+  {
+    if (memcmp(pScreen+i,ready,sizeof(ready))==0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void Report(const char *pName, uint64_t cycles, uint64_t elapsed, uint32_t clockHz)
+{
+  printf("%s: %llu cycles, %.3f s at %.0f Hz, %.3f s host, %.3f MHz\n",pName,
+    (unsigned long long)cycles,cycles/(double)clockHz,(double)clockHz,elapsed/1000000.0,
+    elapsed ? (double)cycles/elapsed : 0.0);
+}
+
+static int Benchmark(RpPetra *pGlue, RP65C02 *pCpu)
+{
+  SYSTEMSTATE systemState={};
+
+  uint64_t start=time_us_64();
+  bool booted=false;
+  while (!booted && totalCycles<BOOT_TIMEOUT_CYCLES)
+  {
+    for (int i=0;i<READY_POLL_CYCLES;i++)
+    {
+      Step(pGlue,&systemState,0);
+    }
+    booted=IsReady(pGlue);
+  }
+  if (!booted)
+  {
+    printf("READY. not found after %llu cycles\n",(unsigned long long)totalCycles);
+    return 1;
+  }
+  Report("boot",totalCycles,time_us_64()-start,pGlue->m_pGovernor->GetClock());
+
+  memcpy(pGlue->m_pRAM+BENCHMARK_ADDR,benchmark,sizeof(benchmark));
+  pCpu->SetPC(BENCHMARK_ADDR);
+  uint64_t first=totalCycles;
+  start=time_us_64();
+  while (!Step(pGlue,&systemState,0xd020))
+  {
+    if (totalCycles-first>BENCHMARK_TIMEOUT_CYCLES)
+    {
+      printf("no write to $D020 after %llu cycles\n",(unsigned long long)(totalCycles-first));
+      return 1;
+    }
+  }
+  Report("loop",totalCycles-first,time_us_64()-start,pGlue->m_pGovernor->GetClock());
+  printf("C64 original 1:30.51, board 1:27.85 at 0.985 MHz, 1:19 at 1.06 MHz, 0:41.51 at 2.04 MHz\n");
+  return 0;
+}
+
+/**
+ * Between BusSequencerModel and the 6510 for -q: keeps the bus cycle the CPU has put on the bus,
+ * to be compared with the packed bus word RpPetra gets, and counts the bytes the CPU latches
+ * that are not the one the read cycle was answered with.
+ */
+class CheckedCpu : public HostCpu {
+
+  private:
+    HostCpu *m_pCpu;
+    HostBus *m_pBus;
+
+  public:
+    uint16_t m_addr;
+    bool m_readNotWrite;
+    uint8_t m_data;
+    uint32_t m_latchMismatches;
+
+    CheckedCpu(HostCpu *pCpu, HostBus *pBus) : m_pCpu(pCpu), m_pBus(pBus), m_addr(0), m_readNotWrite(true), m_data(0), m_latchMismatches(0) {};
+    void Reset() { m_pCpu->Reset();};
+    void SetIRQ(bool enable) { m_pCpu->SetIRQ(enable);};
+    void SetNMI(bool enable) { m_pCpu->SetNMI(enable);};
+    void Latch(uint8_t data)
+    {
+      if (data!=m_pBus->GetReply())
+      {
+        m_latchMismatches++;
+      }
+      m_pCpu->Latch(data);
+    };
+    void NextCycle(uint16_t *pAddr, bool *pReadNotWrite, uint8_t *pData)
+    {
+      m_pCpu->NextCycle(pAddr,pReadNotWrite,pData);
+      m_addr=*pAddr;
+      m_readNotWrite=*pReadNotWrite;
+      m_data=*pData;
+    };
+};
+
+/**
+ * Runs the 6510 through BusSequencerModel into RpPetra::Clk(), once answering each read cycle at
+ * once and once SEQUENCER_REPLY_DELAY PIO clocks late. Checks every packed {A0-A15, R/W, D0-D7}
+ * word and every latched byte, that the state machine stalls on the TX FIFO exactly while a read
+ * cycle is not answered and that no two drivers are on GPIO0-7 at the same time. Reports the cost
+ * per bus cycle against the CPU straight on HostBus.
+ */
+static int SequencerBenchmark(RpPetra *pGlue, RP65C02 *pCpu)
+{
+  static const uint8_t replyDelays[]={0,SEQUENCER_REPLY_DELAY};
+  HostBus *pBus=pGlue->m_pBus;
+  Scheduler *pScheduler=pGlue->m_pScheduler;
+  SYSTEMSTATE systemState={};
+
+  uint64_t first=totalCycles;
+  uint64_t start=time_us_64();
+  while (totalCycles-first<SEQUENCER_CYCLES)
+  {
+    Step(pGlue,&systemState,0);
+  }
+  double direct=(time_us_64()-start)*1000.0/SEQUENCER_CYCLES;
+  printf("sequencer off:     %6.1f ns/cycle\n",direct);
+
+  int result=0;
+  CheckedCpu checkedCpu(pCpu,pBus);
+  pBus->Attach(&checkedCpu);
+  for (uint8_t replyDelay : replyDelays)
+  {
+    BusSequencerModel model(&checkedCpu);
+    pBus->AttachSequencer(&model,replyDelay);
+    pGlue->Reset();
+    checkedCpu.m_latchMismatches=0;
+    uint64_t busCycles=0;
+    uint64_t reads=0;
+    uint32_t wordMismatches=0;
+    first=totalCycles;
+    start=time_us_64();
+    while (totalCycles-first<SEQUENCER_CYCLES)
+    {
+      if (totalCycles>=pScheduler->GetNextEventCycle())
+      {
+        pScheduler->Dispatch(totalCycles);
+      }
+      bool clocked=pGlue->Clk(&systemState,totalCycles);
+      totalCycles++;
+      if (!clocked)
+      {
+        continue; // VIC DMA, no bus word
+      }
+      const CPUSTATE *pState=&systemState.cpuState;
+      busCycles++;
+      reads+=pState->readNotWrite;
+      if (pState->a0a15!=checkedCpu.m_addr || pState->readNotWrite!=checkedCpu.m_readNotWrite ||
+        (!pState->readNotWrite && pState->d0d7!=checkedCpu.m_data))
+      {
+        wordMismatches++;
+      }
+    }
+    uint64_t elapsed=time_us_64()-start;
+    // The last cycle is taken, but not finished by the next falling edge of PHI2
+    bool ok=wordMismatches==0 && checkedCpu.m_latchMismatches==0 && model.GetContentions()==0 &&
+      model.GetBusCycles()+1==busCycles && model.GetStalls()==reads*replyDelay;
+    printf("sequencer delay %u: %6.1f ns/cycle, %.2f PIO clocks/cycle, %llu reads stalled %llu clocks, "
+      "%u contentions, %u word and %u latch mismatches, %s\n",replyDelay,elapsed*1000.0/SEQUENCER_CYCLES,
+      model.GetClocks()/(double)busCycles,(unsigned long long)reads,
+      (unsigned long long)model.GetStalls(),model.GetContentions(),wordMismatches,checkedCpu.m_latchMismatches,ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+      result=1;
+    }
+    pBus->AttachSequencer(nullptr,0);
+  }
+  pBus->Attach(pCpu);
+  return result;
+}
+
+// Raster IRQ acknowledge check: each way of writing $D019 has to release the IRQ exactly once per frame
+static int IrqCheck(RpPetra *pGlue, RP65C02 *pCpu)
+{
+  const VicTiming *pTiming=pGlue->m_pVICII->GetTiming();
+  uint32_t frameCycles=pTiming->cyclesPerLine*pTiming->lines;
+  SYSTEMSTATE systemState={};
+  int result=0;
+  for (const IrqAcknowledge &acknowledge : irqAcknowledges)
+  {
+    pGlue->Reset();
+    uint8_t *pRAM=pGlue->m_pRAM;
+    memcpy(pRAM+BENCHMARK_ADDR,irqSetup,sizeof(irqSetup));
+    memcpy(pRAM+IRQ_HANDLER_ADDR,acknowledge.code,acknowledge.length);
+    memcpy(pRAM+IRQ_HANDLER_ADDR+acknowledge.length,irqHandlerTail,sizeof(irqHandlerTail));
+    pRAM[0xfffe]=IRQ_HANDLER_ADDR & 0xff;
+    pRAM[0xffff]=IRQ_HANDLER_ADDR >> 8;
+    memset(pRAM+IRQ_RESULT_ADDR,0,3);
+    uint64_t first=totalCycles;
+    while (totalCycles-first<IRQ_RESET_CYCLES)
+    {
+      Step(pGlue,&systemState,0); // the RESET sequence, it would fetch the vector after SetPC() too
+    }
+    pCpu->SetPC(BENCHMARK_ADDR);
+    while (totalCycles-first<(uint64_t)frameCycles*IRQ_FRAMES)
+    {
+      Step(pGlue,&systemState,0);
+    }
+    uint8_t latched=pRAM[IRQ_RESULT_ADDR];
+    uint16_t irqs=pRAM[IRQ_RESULT_ADDR+1] | (pRAM[IRQ_RESULT_ADDR+2] << 8);
+    bool ok=irqs==IRQ_FRAMES && latched==0;
+    printf("irq acknowledge %-7s %5u raster IRQs in %d frames, $D019 after acknowledge $%02X, %s\n",acknowledge.pName,
+      irqs,IRQ_FRAMES,latched,ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+      result=1;
+    }
+  }
+  return result;
+}
+
+/**
+ * RpPetra::Clk() before the page tables: the PLA lines from the CPU port on every cycle, then
+ * the address range if/else chain (no cartridge ROMs). The I/O chips are only counted, they
+ * are the same for both decoders.
+ */
+static inline uint8_t ReferenceDecode(RpPetra *pGlue, uint8_t cartridge, const BusTraceRecord *pRecord, uint32_t *pIO)
+{
+  uint8_t *pRAM=pGlue->m_pRAM;
+  uint8_t config=plaTable.config[cartridge | ((pRAM[1] | ~pRAM[0]) & 0x07)];
+  uint16_t addr=pRecord->addr;
+  if (addr<0xd000 || addr>0xdfff)
+  {
+    if (!pRecord->read)
+    {
+      pRAM[addr]=pRecord->data;
+      return pRecord->data;
+    }
+    if (addr>0x9fff && addr<0xc000)
+    {
+      return (config & plaBasic) ? basic_rom[addr-0xa000] : pRAM[addr];
+    }
+    if (addr>0xdfff)
+    {
+      return (config & plaKernal) ? kernal_rom[addr-0xe000] : pRAM[addr];
+    }
+    return pRAM[addr];
+  }
+  if (config & plaIO)
+  {
+    if (addr>0xd7ff && addr<0xdc00) // Colorram
+    {
+      if (!pRecord->read)
+      {
+        pGlue->m_pColorRam[addr-0xd800]=pRecord->data;
+        return pRecord->data;
+      }
+      return pGlue->m_pColorRam[addr-0xd800];
+    }
+    if (addr<0xde00) // VIC, SID, CIA-1, CIA-2
+    {
+      (*pIO)++;
+      return pRecord->read ? 0xff : pRecord->data;
+    }
+  }
+  else if ((config & plaCharRom) && pRecord->read)
+  {
+    return chargen_rom[addr-0xd000];
+  }
+  if (!pRecord->read)
+  {
+    pRAM[addr]=pRecord->data;
+    return pRecord->data;
+  }
+  return pRAM[addr];
+}
+
+// The page table lookup of RpPetra::Clk(), the I/O chips only counted
+static inline uint8_t PageTableDecode(RpPetra *pGlue, const uint8_t * const *pReadPages, uint8_t * const *pWritePages,
+  const BusTraceRecord *pRecord, uint32_t *pIO)
+{
+  uint16_t addr=pRecord->addr;
+  if (pRecord->read)
+  {
+    const uint8_t *pPage=pReadPages[addr >> 8];
+    if (pPage!=nullptr)
+    {
+      return pPage[addr & 0xff];
+    }
+    (*pIO)++;
+    return 0xff;
+  }
+  uint8_t *pPage=pWritePages[addr >> 8];
+  if (pPage!=nullptr)
+  {
+    pPage[addr & 0xff]=pRecord->data;
+    if (addr<2)
+    {
+      pGlue->UpdateMemoryMap();
+    }
+  }
+  else
+  {
+    (*pIO)++;
+  }
+  return pRecord->data;
+}
+
+/**
+ * Replays the bus cycles of a -t trace through the former if/else decoder and through the page
+ * tables, both from the same RAM, color RAM and CPU port. Checks both read the same bytes and
+ * leave the same memory behind and reports ns per cycle.
+ */
+static int DecoderBenchmark(RpPetra *pGlue, const char *pFileName)
+{
+  std::vector<BusTraceRecord> records;
+  if (!ReadBusTrace(pFileName,records))
+  {
+    return 1;
+  }
+  if (records.empty())
+  {
+    printf("%s: no bus cycles\n",pFileName);
+    return 1;
+  }
+  static uint8_t ram[2][65536];
+  static uint8_t colorRam[2][1024];
+  static uint8_t startRam[65536];
+  static uint8_t startColorRam[1024];
+  memcpy(startRam,pGlue->m_pRAM,sizeof(startRam));
+  memcpy(startColorRam,pGlue->m_pColorRam,sizeof(startColorRam));
+  uint8_t cartridge=pGlue->GetPlaInput() & 0x18;
+  size_t repeats=DECODER_CYCLES/records.size()+1;
+
+  uint64_t elapsed[2];
+  uint32_t checksum[2]={0,0};
+  uint32_t io[2]={0,0};
+  for (int pass=0;pass<2;pass++)
+  {
+    memcpy(pGlue->m_pRAM,startRam,sizeof(startRam));
+    memcpy(pGlue->m_pColorRam,startColorRam,sizeof(startColorRam));
+    pGlue->UpdateMemoryMap();
+    const uint8_t * const *pReadPages=pGlue->GetReadPages();
+    uint8_t * const *pWritePages=pGlue->GetWritePages();
+    uint64_t start=time_us_64();
+    for (size_t repeat=0;repeat<repeats;repeat++)
+    {
+      for (const BusTraceRecord &record : records)
+      {
+        uint8_t byte=pass==0 ? ReferenceDecode(pGlue,cartridge,&record,&io[pass]) :
+          PageTableDecode(pGlue,pReadPages,pWritePages,&record,&io[pass]);
+        checksum[pass]=checksum[pass]*31+byte;
+      }
+    }
+    elapsed[pass]=time_us_64()-start;
+    memcpy(ram[pass],pGlue->m_pRAM,sizeof(ram[pass]));
+    memcpy(colorRam[pass],pGlue->m_pColorRam,sizeof(colorRam[pass]));
+  }
+  bool same=checksum[0]==checksum[1] && io[0]==io[1] && memcmp(ram[0],ram[1],sizeof(ram[0]))==0 &&
+    memcmp(colorRam[0],colorRam[1],sizeof(colorRam[0]))==0;
+  uint64_t cycles=repeats*records.size();
+  printf("decoder: %zu trace cycles replayed %zu times, if/else %.2f ns/cycle, page tables %.2f ns/cycle, %u I/O accesses, %s\n",
+    records.size(),repeats,elapsed[0]*1000.0/cycles,elapsed[1]*1000.0/cycles,io[1],same ? "identical" : "MISMATCH");
+  return same ? 0 : 1;
+}
+
+// The pixel expansion as it was before the lookup tables, reference for -r
+static void ReferenceExpand(uint8_t *pDest, uint8_t bits, uint8_t foregroundColor, uint8_t backgroundColor)
+{
+  for (int i=0;i<4;i++)
+  {
+    pDest[i]=((bits & 0x80) ? foregroundColor : backgroundColor) << 4;
+    pDest[i]|=(bits & 0x40) ? foregroundColor : backgroundColor;
+    bits<<=2;
+  }
+}
+
+static void ReferenceExpandMulticolor(uint8_t *pDest, uint8_t bits, const uint8_t *pColors)
+{
+  for (int i=0;i<4;i++)
+  {
+    pDest[i]=pColors[bits >> 6] << 4;
+    pDest[i]|=pColors[bits >> 6];
+    bits<<=2;
+  }
+}
+
+// A display line from RAM (no CHARGEN, the bank is $4000)
+static void ReferenceLine(RpPetra *pGlue, const VicLine *pLine, uint8_t *pFrameBuffer)
+{
+  static const uint16_t bankTab[4]={0xc000,0x8000,0x4000,0x0000};
+  uint16_t scanLine=pLine->line-(END_SCANLINE_UPPER_BORDER_PAL+1);
+  uint8_t *pDest=pFrameBuffer+scanLine*160;
+  uint16_t bank=bankTab[pLine->bank];
+  uint16_t videoRam=bank+((pLine->d018>>4)*0x400);
+  uint16_t charRam=bank+(((pLine->d018>>1) & 0x07)*0x800);
+  uint16_t bitmap=bank+((pLine->d018 & 0x08) ? 0x2000 : 0);
+  uint16_t curRow=scanLine/8;
+
+  for (int i=0;i<40;i++)
+  {
+    int offset=curRow*40+i;
+    uint8_t character=pGlue->m_pRAM[videoRam+offset];
+    uint8_t bits;
+    uint8_t foregroundColor=pGlue->m_pColorRam[offset] & 0x0f;
+    uint8_t backgroundColor=pLine->background[0] & 0x0f;
+    uint8_t colors[4]={backgroundColor,(uint8_t)(pLine->background[1] & 0x0f),(uint8_t)(pLine->background[2] & 0x0f),0};
+    if ((pLine->d011 & 0x20) && (pLine->d016 & 0x10))
+    {
+      bits=pGlue->m_pRAM[(uint16_t)(bitmap+curRow*320+i*8+scanLine % 8)];
+      colors[1]=character >> 4;
+      colors[2]=character & 0x0f;
+      colors[3]=pGlue->m_pColorRam[offset] & 0x0f;
+      ReferenceExpandMulticolor(pDest+i*4,bits,colors);
+      continue;
+    }
+    else if (pLine->d011 & 0x20)
+    {
+      bits=pGlue->m_pRAM[(uint16_t)(bitmap+curRow*320+i*8+scanLine % 8)];
+      foregroundColor=character >> 4;
+      backgroundColor=character & 0x0f;
+    }
+    else if (pLine->d011 & 0x40)
+    {
+      backgroundColor=pLine->background[character/64] & 0x0f;
+      bits=pGlue->m_pRAM[charRam+8*(character % 64)+scanLine % 8];
+    }
+    else if (pLine->d016 & 0x10)
+    {
+      bits=pGlue->m_pRAM[charRam+8*character+scanLine % 8];
+      colors[3]=pGlue->m_pColorRam[offset] & 0x07;
+      if (pGlue->m_pColorRam[offset] & 8)
+      {
+        ReferenceExpandMulticolor(pDest+i*4,bits,colors);
+        continue;
+      }
+      foregroundColor=colors[3];
+    }
+    else
+    {
+      bits=pGlue->m_pRAM[charRam+8*character+scanLine % 8];
+    }
+    ReferenceExpand(pDest+i*4,bits,foregroundColor,backgroundColor);
+  }
+}
+
+// The display window of the first lines of the VIC frame buffer against the reference
+static bool IsSameWindow(VIC6569 *pVIC, const uint8_t *pReference, int lines)
+{
+  for (int i=0;i<lines;i++)
+  {
+    if (memcmp(pReference+i*160,pVIC->GetLinePixels(END_SCANLINE_UPPER_BORDER_PAL+1+i),160)!=0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// RAM and color RAM with pseudo random bytes
+static void FillRandom(RpPetra *pGlue)
+{
+  uint32_t seed=0x6569;
+  for (int i=0;i<0x10000;i++)
+  {
+    seed^=seed << 13;
+    seed^=seed >> 17;
+    seed^=seed << 5;
+    pGlue->m_pRAM[i]=seed;
+    pGlue->m_pColorRam[i & 0x3ff]=seed >> 8;
+  }
+}
+
+static int RenderBenchmark(RpPetra *pGlue)
+{
+  static const struct { const char *pName; uint8_t d011; uint8_t d016; uint8_t d018; } modes[]={
+    {"standard text",0x1b,0x08,0x14},
+    {"multicolor text",0x1b,0x18,0x14},
+    {"extended color",0x5b,0x08,0x14},
+    {"standard bitmap",0x3b,0x08,0x18},
+    {"multicolor bitmap",0x3b,0x18,0x18},
+  };
+  VIC6569 *pVIC=pGlue->m_pVICII;
+  static uint8_t reference[160*200];
+  FillRandom(pGlue);
+
+  int result=0;
+  for (const auto &mode : modes)
+  {
+    VicLine line={0,mode.d011,mode.d016,mode.d018,2,{0x06,0x02,0x05,0x0e}};
+    uint64_t elapsed[2];
+    for (int pass=0;pass<2;pass++)
+    {
+      uint64_t start=time_us_64();
+      for (int frame=0;frame<RENDER_FRAMES;frame++)
+      {
+        for (line.line=END_SCANLINE_UPPER_BORDER_PAL+1;line.line<START_SCANLINE_LOWER_BORDER_PAL;line.line++)
+        {
+          if (pass==0)
+          {
+            ReferenceLine(pGlue,&line,reference);
+          }
+          else
+          {
+            pVIC->Render(&line);
+          }
+        }
+      }
+      elapsed[pass]=time_us_64()-start;
+    }
+    bool same=IsSameWindow(pVIC,reference,200);
+    printf("%-17s bit by bit %6.1f ns/line, tables %6.1f ns/line, %s\n",mode.pName,
+      elapsed[0]*1000.0/(RENDER_FRAMES*200),elapsed[1]*1000.0/(RENDER_FRAMES*200),same ? "identical" : "MISMATCH");
+    if (!same)
+    {
+      result=1;
+    }
+  }
+
+  // Every colour combination of the multicolor modes on the first 7 character rows, where
+  // screen RAM holds all 256 values: $D021-$D023 times all color RAM bytes in text mode,
+  // $D021 times the color RAM nibble times both screen RAM nibbles in bitmap mode.
+  for (int i=0;i<1000;i++)
+  {
+    pGlue->m_pRAM[0x4400+i]=i;
+  }
+  int mismatches=0;
+  for (int combination=0;combination<16*16*16+16*16;combination++)
+  {
+    VicLine line={0,0x1b,0x18,0x14,2,{(uint8_t)(combination & 0x0f),(uint8_t)((combination >> 4) & 0x0f),(uint8_t)((combination >> 8) & 0x0f),0}};
+    for (int i=0;i<1000;i++)
+    {
+      pGlue->m_pColorRam[i]=i;
+    }
+    if (combination>=16*16*16)
+    {
+      line.d011=0x3b;
+      line.d018=0x18;
+      for (int i=0;i<1000;i++)
+      {
+        pGlue->m_pColorRam[i]=line.background[1];
+      }
+    }
+    for (line.line=END_SCANLINE_UPPER_BORDER_PAL+1;line.line<END_SCANLINE_UPPER_BORDER_PAL+1+7*8;line.line++)
+    {
+      ReferenceLine(pGlue,&line,reference);
+      pVIC->Render(&line);
+    }
+    if (!IsSameWindow(pVIC,reference,7*8))
+    {
+      mismatches++;
+    }
+  }
+  printf("multicolor colour combinations: %d mismatches\n",mismatches);
+  if (mismatches)
+  {
+    result=1;
+  }
+  return result;
+}
+
+// beamRace() before the twin pixel palette, two lookups and two 16-bit stores per byte
+static void ReferenceScanLine(const uint8_t *pFrameLine, uint16_t *pScanLine)
+{
+  const uint8_t *pBytes=pFrameLine+SCANLINE_OFFSET;
+  for (int i=0;i<SCANLINE_PIXELS/2;i++)
+  {
+    pScanLine[2*i]=colorIndex[pBytes[i] >> 4];
+    pScanLine[2*i+1]=colorIndex[pBytes[i] & 15];
+  }
+}
+
+/**
+ * Times the DVI scanline conversion of beamRace() on a bitmap frame with 40 and 38 columns and
+ * with the display switched off, as RGB565 and as colour indices for the _TMDS_PALETTE output.
+ * Then whole frames the way beamRace() builds them, into one scanline buffer: every line
+ * converted, and with the border only lines kept in the buffer (BuildScanLine()).
+ */
+static int ScanLineBenchmark(RpPetra *pGlue)
+{
+  static const struct { const char *pName; uint8_t d016; uint8_t window; bool displayOff; } modes[]={
+    {"40 columns",0x08,0,false},
+    {"38 columns",0x00,VIC_WINDOW_LEFT38 | VIC_WINDOW_RIGHT38,false},
+    {"display off",0x08,0,true},
+  };
+  VIC6569 *pVIC=pGlue->m_pVICII;
+  static uint16_t reference[VIC_FRAME_LINES][SCANLINE_PIXELS];
+  static uint32_t scanLines[VIC_FRAME_LINES][SCANLINE_PIXELS/2];
+  static uint8_t indices[VIC_FRAME_LINES][2*SCANLINE_PIXELS];
+  FillRandom(pGlue);
+
+  int result=0;
+  for (const auto &mode : modes)
+  {
+    VicLine line={0,0x3b,mode.d016,0x18,2,{0x06},0x0e};
+    for (line.line=VIC_FRAME_FIRST_LINE;line.line<VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES;line.line++)
+    {
+      bool border=mode.displayOff || line.line<=END_SCANLINE_UPPER_BORDER_PAL || line.line>=START_SCANLINE_LOWER_BORDER_PAL;
+      line.window=border ? VIC_WINDOW_BORDER : mode.window;
+      pVIC->Render(&line);
+    }
+    uint64_t elapsed[3];
+    for (int pass=0;pass<3;pass++)
+    {
+      uint64_t start=time_us_64();
+      for (int frame=0;frame<RENDER_FRAMES;frame++)
+      {
+        for (int row=0;row<VIC_FRAME_LINES;row++)
+        {
+          const uint8_t *pFrameLine=pVIC->GetFrameLine(VIC_FRAME_FIRST_LINE+row);
+          if (pass==0)
+          {
+            ReferenceScanLine(pFrameLine,reference[row]);
+          }
+          else if (pass==1)
+          {
+            ConvertScanLine(pFrameLine,scanLines[row]);
+          }
+          else
+          {
+            ExpandScanLine(pFrameLine,(uint32_t *)indices[row]);
+          }
+        }
+      }
+      elapsed[pass]=time_us_64()-start;
+    }
+    bool same=memcmp(reference,scanLines,sizeof(reference))==0;
+    for (int row=0;row<VIC_FRAME_LINES;row++)
+    {
+      for (int pixel=0;pixel<SCANLINE_PIXELS;pixel++)
+      {
+        uint8_t color=indices[row][2*pixel];
+        if (color!=indices[row][2*pixel+1] || colorIndex[color]!=reference[row][pixel])
+        {
+          same=false;
+        }
+      }
+    }
+    printf("scanline %-11s two lookups %6.1f ns/line, twin pixels %6.1f ns/line, palette indices %6.1f ns/line, %s\n",mode.pName,
+      elapsed[0]*1000.0/(RENDER_FRAMES*VIC_FRAME_LINES),elapsed[1]*1000.0/(RENDER_FRAMES*VIC_FRAME_LINES),
+      elapsed[2]*1000.0/(RENDER_FRAMES*VIC_FRAME_LINES),same ? "identical" : "MISMATCH");
+    if (!same)
+    {
+      result=1;
+    }
+
+    static uint32_t scanLine[SCANLINE_PIXELS/2];
+    ScanLineCache cache={nullptr,VIC_LINE_FILL_MIXED};
+    uint32_t written=0;
+    for (int pass=0;pass<2;pass++)
+    {
+      uint64_t start=time_us_64();
+      for (int frame=0;frame<RENDER_FRAMES;frame++)
+      {
+        for (int row=0;row<VIC_FRAME_LINES;row++)
+        {
+          const uint8_t *pFrameLine=pVIC->GetFrameLine(VIC_FRAME_FIRST_LINE+row);
+          if (pass==0)
+          {
+            ConvertScanLine(pFrameLine,scanLine);
+          }
+          else if (BuildScanLine(&cache,pFrameLine,pVIC->GetLineFill(pFrameLine),scanLine))
+          {
+            written++;
+          }
+        }
+      }
+      elapsed[pass]=time_us_64()-start;
+    }
+    // Each line as the DVI output gets it, with the buffer kept from the line before
+    for (int row=0;row<VIC_FRAME_LINES;row++)
+    {
+      const uint8_t *pFrameLine=pVIC->GetFrameLine(VIC_FRAME_FIRST_LINE+row);
+      BuildScanLine(&cache,pFrameLine,pVIC->GetLineFill(pFrameLine),scanLine);
+      if (memcmp(scanLine,scanLines[row],sizeof(scanLine))!=0)
+      {
+        same=false;
+      }
+    }
+    printf("beamRace %-11s %3u of %d lines written, converted %6.2f us/frame, cached %6.2f us/frame, %s\n",mode.pName,
+      written/RENDER_FRAMES,VIC_FRAME_LINES,elapsed[0]/(double)RENDER_FRAMES,elapsed[1]/(double)RENDER_FRAMES,same ? "identical" : "MISMATCH");
+    if (!same)
+    {
+      result=1;
+    }
+  }
+  return result;
+}
+
+static void Usage(const char *pName)
+{
+  fprintf(stderr,"usage: %s [-t trace.bin] [-p pal|ntsc] [-m 6569|6567r8|6567r56a] [cycles|-b]\n"
+    "       %s -r|-s|-q|-i\n"
+    "       %s -a trace.bin\n",pName,pName,pName);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *pName=argv[0];
+  Logging *pLog=new Logging(new AnsiTerminal(), Info);
+  SIDInit();
+  RP65C02 *pCpu=new RP65C02(pLog);
+  RpPetra *pGlue=new RpPetra(pLog, pCpu);
+  pGlue->m_pBus->Attach(pCpu);
+  Governor *pGovernor=pGlue->m_pGovernor;
+  bool paced=false;
+
+  while (argc>2 && (strcmp(argv[1],"-t")==0 || strcmp(argv[1],"-p")==0 || strcmp(argv[1],"-m")==0))
+  {
+    if (strcmp(argv[1],"-t")==0)
+    {
+      pTraceFile=fopen(argv[2],"wb");
+      if (pTraceFile==nullptr)
+      {
+        perror(argv[2]);
+        return 1;
+      }
+      pGlue->m_pScheduler->Register(EventBusTrace,WriteTrace,pGlue->m_pBusTrace);
+      pGlue->m_pScheduler->Schedule(EventBusTrace,BUS_TRACE_ENTRIES/2,BUS_TRACE_ENTRIES/2);
+      pGlue->m_pBusTrace->Start();
+    }
+    else if (strcmp(argv[1],"-m")==0)
+    {
+      if (strcmp(argv[2],"6567r8")==0)
+      {
+        pGlue->SetVicModel(Vic6567R8);
+      }
+      else if (strcmp(argv[2],"6567r56a")==0)
+      {
+        pGlue->SetVicModel(Vic6567R56A);
+      }
+      else if (strcmp(argv[2],"6569")==0)
+      {
+        pGlue->SetVicModel(Vic6569);
+      }
+      else
+      {
+        Usage(pName);
+        return 1;
+      }
+    }
+    else
+    {
+      // Paced at the clock of the 6569 (pal) or the 6567R8 (ntsc)
+      if (strcmp(argv[2],"pal")!=0 && strcmp(argv[2],"ntsc")!=0)
+      {
+        Usage(pName);
+        return 1;
+      }
+      paced=true;
+      pGlue->SetVicModel(strcmp(argv[2],"ntsc")==0 ? Vic6567R8 : Vic6569);
+    }
+    argc-=2;
+    argv+=2;
+  }
+  // Unpaced by default, the host is a benchmark
+  if (!paced)
+  {
+    pGovernor->SetWarp(true);
+  }
+
+  int result=0;
+  if (argc>1 && strcmp(argv[1],"-b")==0)
+  {
+    result=Benchmark(pGlue,pCpu);
+  }
+  else if (argc>1 && strcmp(argv[1],"-r")==0)
+  {
+    result=RenderBenchmark(pGlue);
+  }
+  else if (argc>1 && strcmp(argv[1],"-s")==0)
+  {
+    result=ScanLineBenchmark(pGlue);
+  }
+  else if (argc>2 && strcmp(argv[1],"-a")==0)
+  {
+    result=DecoderBenchmark(pGlue,argv[2]);
+  }
+  else if (argc>1 && strcmp(argv[1],"-q")==0)
+  {
+    result=SequencerBenchmark(pGlue,pCpu);
+  }
+  else if (argc>1 && strcmp(argv[1],"-i")==0)
+  {
+    result=IrqCheck(pGlue,pCpu);
+  }
+  else
+  {
+    uint64_t cycles=DEFAULT_HOST_CYCLES;
+    char *pEnd=nullptr;
+    if (argc>1)
+    {
+      cycles=strtoull(argv[1],&pEnd,0);
+    }
+    // Anything else than a single number, e.g. -h or an unknown option
+    if (argc>2 || (argc>1 && (!isdigit((unsigned char)argv[1][0]) || *pEnd!='\0')))
+    {
+      Usage(pName);
+      return 1;
+    }
+    SYSTEMSTATE systemState={};
+    uint64_t start=time_us_64();
+    while (totalCycles<cycles)
+    {
+      Step(pGlue,&systemState,0);
+    }
+    Report("run",cycles,time_us_64()-start,pGovernor->GetClock());
+    VIC6569 *pVIC=pGlue->m_pVICII;
+    uint32_t lines=pVIC->GetLinesRendered()+pVIC->GetLinesSkipped();
+    printf("vic: %u lines rendered, %u unchanged lines skipped (%.1f%%)\n",pVIC->GetLinesRendered(),
+      pVIC->GetLinesSkipped(),lines ? pVIC->GetLinesSkipped()*100.0/lines : 0.0);
+    if (paced)
+    {
+      printf("governor: %u Hz achieved, %u Hz max\n",pGovernor->GetAchievedHz(),pGovernor->GetMaxHz());
+    }
+  }
+  if (pTraceFile!=nullptr)
+  {
+    WriteTrace(pGlue->m_pBusTrace,totalCycles);
+    fclose(pTraceFile);
+  }
+  delete pGlue;
+  delete pLog;
+  return result;
+}
@@ -0,0 +1,31 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * The few Pico SDK calls left in the chip emulation, mapped to the host (_HOST).
+*/
+
+#ifndef _HOST_PLATFORM_HXX
+#define _HOST_PLATFORM_HXX
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define __not_in_flash_func(func_name) func_name
+#define __not_in_flash(group)
+#define __in_flash(group)
+#define __compiler_memory_barrier() __asm__ volatile ("" : : : "memory")
+#define __dmb() __sync_synchronize()
+
+static inline uint64_t time_us_64()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (uint64_t)now.tv_sec*1000000+now.tv_nsec/1000;
+}
+
+static inline void sleep_us(uint64_t us) { usleep(us); }
+static inline void sleep_ms(uint32_t ms) { usleep(ms*1000); }
+
+#endif
@@ -0,0 +1,338 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ *
+ * Decode tables of the software 6510 in RP65C02. All 256 opcodes (NMOS, including the
+ * undocumented ones) are decoded at compile time from the aaabbbcc opcode layout into
+ * an operation and a bus cycle sequence. Every entry of a sequence is one bus cycle,
+ * exactly as the real chip puts it on the bus (dummy reads and writes included).
+*/
+
+#ifndef _OPCODES_6510_HXX
+#define _OPCODES_6510_HXX
+
+// Operations, what is done with the data of a sequence
+typedef enum {
+  opNone=0,
+  // Read
+  opORA, opAND, opEOR, opADC, opLDA, opCMP, opSBC, opLDX, opLDY, opCPX, opCPY, opBIT, opNOP,
+  opLAX, opLAS, opANC, opALR, opARR, opANE, opLXA, opSBX,
+  // Write
+  opSTA, opSTX, opSTY, opSAX, opSHA, opSHX, opSHY, opTAS,
+  // Read-modify-write
+  opASL, opROL, opLSR, opROR, opDEC, opINC, opSLO, opRLA, opSRE, opRRA, opDCP, opISC,
+  // Implied
+  opTXA, opTAX, opDEX, opTXS, opTSX, opDEY, opTAY, opTYA, opINY, opINX,
+  opCLC, opSEC, opCLI, opSEI, opCLV, opCLD, opSED,
+  opASLA, opROLA, opLSRA, opRORA,
+  // Branches
+  opBPL, opBMI, opBVC, opBVS, opBCC, opBCS, opBNE, opBEQ,
+  // Control
+  opBRK, opJSR, opRTI, opRTS, opJMP, opPHP, opPLP, opPHA, opPLA, opJAM
+} CpuOp;
+
+typedef enum {
+  modeImplied=0, modeImmediate, modeZeroPage, modeZeroPageX, modeZeroPageY, modeAbsolute,
+  modeAbsoluteX, modeAbsoluteY, modeIndirectX, modeIndirectY, modeRelative, modeIndirect,
+  modeControl // BRK, JSR, RTI, RTS, JMP abs, stack, JAM: sequence depends on the operation
+} CpuMode;
+
+// One bus cycle each
+typedef enum {
+  uopEnd=0,
+  uopFetch,         // read PC: opcode
+  uopImplied,       // read PC (dummy), execute
+  uopImmediate,     // read PC++, execute
+  uopDummyPC,       // read PC (dummy)
+  uopAddrLo,        // read PC++: address low byte, zero page address
+  uopAddrHi,        // read PC++: address high byte
+  uopZeroPageX,     // read zero page address (dummy), add X
+  uopZeroPageY,     // read zero page address (dummy), add Y
+  uopPointerX,      // read pointer (dummy), add X
+  uopPointerLo,     // read pointer: address low byte
+  uopPointerHi,     // read pointer+1 (zero page wrap): address high byte
+  uopIndexXRead,    // read address+X without carry, done if the page was not crossed
+  uopIndexYRead,    // read address+Y without carry, done if the page was not crossed
+  uopIndexXDummy,   // read address+X without carry (dummy)
+  uopIndexYDummy,   // read address+Y without carry (dummy)
+  uopRead,          // read address, execute
+  uopWrite,         // write address
+  uopRmwRead,       // read address
+  uopRmwDummy,      // write the unmodified value back (NMOS), modify
+  uopRmwWrite,      // write the modified value
+  uopBranch,        // read PC++: offset, done if the condition is false
+  uopBranchTaken,   // read PC (dummy), add offset to PCL, done if the page was not crossed
+  uopBranchFix,     // read PC with the wrong PCH (dummy), fix PCH
+  uopJmpAbs,        // read PC: address high byte, jump
+  uopJmpIndLo,      // read address
+  uopJmpIndHi,      // read address+1 without carry, jump
+  uopStackDummy,    // read stack (dummy)
+  uopPushPCH,       // write PCH to stack (read during RESET)
+  uopPushPCL,       // write PCL to stack (read during RESET)
+  uopPushP,         // write P to stack (read during RESET), select the vector
+  uopPushA,         // PHA
+  uopPushPhp,       // PHP
+  uopPullA,         // PLA
+  uopPullPlp,       // PLP
+  uopPullP,         // RTI
+  uopPullPCL,
+  uopPullPCH,       // RTS, RTI
+  uopRtsInc,        // read PC++ (dummy)
+  uopJsrAddrHi,     // read PC: address high byte, jump
+  uopBrk,           // read PC (PC++ for BRK only)
+  uopVectorLo,      // read vector, set I
+  uopVectorHi,      // read vector+1, jump
+  uopJam            // read $FFFF forever
+} CpuUop;
+
+#define CPU_MAX_SEQUENCE 8
+
+constexpr bool IsReadOp(CpuOp op) { return op>=opORA && op<=opSBX; }
+constexpr bool IsWriteOp(CpuOp op) { return op>=opSTA && op<=opTAS; }
+constexpr bool IsRmwOp(CpuOp op) { return op>=opASL && op<=opISC; }
+constexpr bool IsBranchOp(CpuOp op) { return op>=opBPL && op<=opBEQ; }
+
+struct CpuOpcode {
+  CpuOp op;
+  CpuMode mode;
+};
+
+constexpr CpuOpcode DecodeOpcode(uint8_t opcode)
+{
+  constexpr CpuOp aluOps[8]={opORA,opAND,opEOR,opADC,opSTA,opLDA,opCMP,opSBC};
+  constexpr CpuOp rmwOps[8]={opASL,opROL,opLSR,opROR,opSTX,opLDX,opDEC,opINC};
+  constexpr CpuOp comboOps[8]={opSLO,opRLA,opSRE,opRRA,opSAX,opLAX,opDCP,opISC};
+  constexpr CpuMode aluModes[8]={modeIndirectX,modeZeroPage,modeImmediate,modeAbsolute,
+                                 modeIndirectY,modeZeroPageX,modeAbsoluteY,modeAbsoluteX};
+  uint8_t aaa=opcode >> 5;
+  uint8_t bbb=(opcode >> 2) & 0x07;
+  uint8_t cc=opcode & 0x03;
+
+  if (cc==0x01) // ALU
+  {
+    if (opcode==0x89)
+    {
+      return {opNOP,modeImmediate};
+    }
+    return {aluOps[aaa],aluModes[bbb]};
+  }
+  if (cc==0x02) // Shifts, X register
+  {
+    switch (bbb)
+    {
+      case 0:
+        if (aaa==5) return {opLDX,modeImmediate};
+        if (aaa>=4) return {opNOP,modeImmediate};
+        return {opJAM,modeControl};
+      case 2:
+      {
+        constexpr CpuOp ops[8]={opASLA,opROLA,opLSRA,opRORA,opTXA,opTAX,opDEX,opNOP};
+        return {ops[aaa],modeImplied};
+      }
+      case 4:
+        return {opJAM,modeControl};
+      case 6:
+        if (aaa==4) return {opTXS,modeImplied};
+        if (aaa==5) return {opTSX,modeImplied};
+        return {opNOP,modeImplied};
+      case 5:
+        return {rmwOps[aaa],(aaa==4 || aaa==5) ? modeZeroPageY : modeZeroPageX};
+      case 7:
+        if (aaa==4) return {opSHX,modeAbsoluteY};
+        return {rmwOps[aaa],aaa==5 ? modeAbsoluteY : modeAbsoluteX};
+      default: // 1 zero page, 3 absolute
+        return {rmwOps[aaa],bbb==1 ? modeZeroPage : modeAbsolute};
+    }
+  }
+  if (cc==0x03) // Undocumented ALU and shift combinations
+  {
+    switch (bbb)
+    {
+      case 2:
+      {
+        constexpr CpuOp ops[8]={opANC,opANC,opALR,opARR,opANE,opLXA,opSBX,opSBC};
+        return {ops[aaa],modeImmediate};
+      }
+      case 4:
+        return {aaa==4 ? opSHA : comboOps[aaa],modeIndirectY};
+      case 5:
+        return {comboOps[aaa],(aaa==4 || aaa==5) ? modeZeroPageY : modeZeroPageX};
+      case 6:
+        if (aaa==4) return {opTAS,modeAbsoluteY};
+        if (aaa==5) return {opLAS,modeAbsoluteY};
+        return {comboOps[aaa],modeAbsoluteY};
+      case 7:
+        if (aaa==4) return {opSHA,modeAbsoluteY};
+        return {comboOps[aaa],aaa==5 ? modeAbsoluteY : modeAbsoluteX};
+      default:
+        return {comboOps[aaa],aluModes[bbb]};
+    }
+  }
+  // cc==0x00, control
+  switch (bbb)
+  {
+    case 0:
+    {
+      constexpr CpuOp ops[8]={opBRK,opJSR,opRTI,opRTS,opNOP,opLDY,opCPY,opCPX};
+      return {ops[aaa],aaa<4 ? modeControl : modeImmediate};
+    }
+    case 1:
+    {
+      constexpr CpuOp ops[8]={opNOP,opBIT,opNOP,opNOP,opSTY,opLDY,opCPY,opCPX};
+      return {ops[aaa],modeZeroPage};
+    }
+    case 2:
+    {
+      constexpr CpuOp ops[8]={opPHP,opPLP,opPHA,opPLA,opDEY,opTAY,opINY,opINX};
+      return {ops[aaa],aaa<4 ? modeControl : modeImplied};
+    }
+    case 3:
+    {
+      constexpr CpuOp ops[8]={opNOP,opBIT,opJMP,opJMP,opSTY,opLDY,opCPY,opCPX};
+      if (aaa==2) return {opJMP,modeControl};
+      if (aaa==3) return {opJMP,modeIndirect};
+      return {ops[aaa],modeAbsolute};
+    }
+    case 4:
+    {
+      constexpr CpuOp ops[8]={opBPL,opBMI,opBVC,opBVS,opBCC,opBCS,opBNE,opBEQ};
+      return {ops[aaa],modeRelative};
+    }
+    case 5:
+      if (aaa==4) return {opSTY,modeZeroPageX};
+      if (aaa==5) return {opLDY,modeZeroPageX};
+      return {opNOP,modeZeroPageX};
+    case 6:
+    {
+      constexpr CpuOp ops[8]={opCLC,opSEC,opCLI,opSEI,opTYA,opCLV,opCLD,opSED};
+      return {ops[aaa],modeImplied};
+    }
+    default: // 7
+      if (aaa==4) return {opSHY,modeAbsoluteX};
+      if (aaa==5) return {opLDY,modeAbsoluteX};
+      return {opNOP,modeAbsoluteX};
+  }
+}
+
+struct CpuSequence {
+  CpuUop uop[CPU_MAX_SEQUENCE];
+};
+
+// Bus cycles after the opcode fetch
+constexpr CpuSequence SequenceOf(CpuOpcode opcode)
+{
+  CpuOp op=opcode.op;
+  // Tail of a memory access, depending on the kind of operation
+  CpuUop tail[3]={uopRead,uopEnd,uopEnd};
+  if (IsWriteOp(op))
+  {
+    tail[0]=uopWrite;
+  }
+  else if (IsRmwOp(op))
+  {
+    tail[0]=uopRmwRead;
+    tail[1]=uopRmwDummy;
+    tail[2]=uopRmwWrite;
+  }
+  bool isRead=IsReadOp(op);
+
+  switch (opcode.mode)
+  {
+    case modeImplied:   return {{uopImplied}};
+    case modeImmediate: return {{uopImmediate}};
+    case modeRelative:  return {{uopBranch,uopBranchTaken,uopBranchFix}};
+    case modeIndirect:  return {{uopAddrLo,uopAddrHi,uopJmpIndLo,uopJmpIndHi}};
+    case modeZeroPage:  return {{uopAddrLo,tail[0],tail[1],tail[2]}};
+    case modeZeroPageX: return {{uopAddrLo,uopZeroPageX,tail[0],tail[1],tail[2]}};
+    case modeZeroPageY: return {{uopAddrLo,uopZeroPageY,tail[0],tail[1],tail[2]}};
+    case modeAbsolute:  return {{uopAddrLo,uopAddrHi,tail[0],tail[1],tail[2]}};
+    case modeAbsoluteX: return {{uopAddrLo,uopAddrHi,isRead ? uopIndexXRead : uopIndexXDummy,tail[0],tail[1],tail[2]}};
+    case modeAbsoluteY: return {{uopAddrLo,uopAddrHi,isRead ? uopIndexYRead : uopIndexYDummy,tail[0],tail[1],tail[2]}};
+    case modeIndirectX: return {{uopAddrLo,uopPointerX,uopPointerLo,uopPointerHi,tail[0],tail[1],tail[2]}};
+    case modeIndirectY: return {{uopAddrLo,uopPointerLo,uopPointerHi,isRead ? uopIndexYRead : uopIndexYDummy,tail[0],tail[1],tail[2]}};
+    default: // modeControl
+      switch (op)
+      {
+        case opBRK: return {{uopBrk,uopPushPCH,uopPushPCL,uopPushP,uopVectorLo,uopVectorHi}};
+        case opJSR: return {{uopAddrLo,uopStackDummy,uopPushPCH,uopPushPCL,uopJsrAddrHi}};
+        case opRTI: return {{uopDummyPC,uopStackDummy,uopPullP,uopPullPCL,uopPullPCH}};
+        case opRTS: return {{uopDummyPC,uopStackDummy,uopPullPCL,uopPullPCH,uopRtsInc}};
+        case opJMP: return {{uopAddrLo,uopJmpAbs}};
+        case opPHP: return {{uopDummyPC,uopPushPhp}};
+        case opPHA: return {{uopDummyPC,uopPushA}};
+        case opPLP: return {{uopDummyPC,uopStackDummy,uopPullPlp}};
+        case opPLA: return {{uopDummyPC,uopStackDummy,uopPullA}};
+        default:    return {{uopJam}};
+      }
+  }
+}
+
+// Cycles without page crossing and not taken branches, for the checks below
+constexpr uint8_t BaseCycles(const CpuSequence &sequence)
+{
+  uint8_t cycles=1;
+  for (uint8_t i=0;i<CPU_MAX_SEQUENCE && sequence.uop[i]!=uopEnd;i++)
+  {
+    CpuUop uop=sequence.uop[i];
+    if (uop!=uopBranchTaken && uop!=uopBranchFix)
+    {
+      cycles++;
+    }
+    if (uop==uopIndexXRead || uop==uopIndexYRead)
+    {
+      cycles--; // the read of the operation is skipped
+    }
+  }
+  return cycles;
+}
+
+struct CpuDecodeTable {
+  CpuOp op[256];
+  CpuSequence sequence[256];
+  uint8_t cycles[256];
+
+  constexpr CpuDecodeTable() : op(), sequence(), cycles()
+  {
+    for (int opcode=0;opcode<256;opcode++)
+    {
+      CpuOpcode decoded=DecodeOpcode(opcode);
+      op[opcode]=decoded.op;
+      sequence[opcode]=SequenceOf(decoded);
+      cycles[opcode]=BaseCycles(sequence[opcode]);
+    }
+  }
+};
+
+constexpr CpuDecodeTable cpuDecodeTable;
+
+// Documented cycle counts of the NMOS 6502, JAM opcodes (x2) are 0
+constexpr uint8_t cpuCycles6502[256]={
+  7,6,0,8,3,3,5,5,3,2,2,2,4,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+  6,6,0,8,3,3,5,5,4,2,2,2,4,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+  6,6,0,8,3,3,5,5,3,2,2,2,3,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+  6,6,0,8,3,3,5,5,4,2,2,2,5,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+  2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, 2,6,0,6,4,4,4,4,2,5,2,5,5,5,5,5,
+  2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, 2,5,0,5,4,4,4,4,2,4,2,4,4,4,4,4,
+  2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+  2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, 2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7
+};
+
+constexpr bool CheckCycles()
+{
+  for (int opcode=0;opcode<256;opcode++)
+  {
+    if (cpuCycles6502[opcode]!=0 && cpuCycles6502[opcode]!=cpuDecodeTable.cycles[opcode])
+    {
+      return false;
+    }
+    if ((cpuCycles6502[opcode]==0)!=(cpuDecodeTable.op[opcode]==opJAM))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(CheckCycles(), "Bus cycle sequences do not match the 6502 cycle counts");
+static_assert(cpuDecodeTable.op[0xa9]==opLDA && cpuDecodeTable.op[0xeb]==opSBC && cpuDecodeTable.op[0xbb]==opLAS, "Opcode decode");
+
+#endif
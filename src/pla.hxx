@@ -0,0 +1,93 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * The C-64 PLA (906114-01). The memory configuration only depends on five lines:
+ * LORAM, HIRAM, CHAREN (CPU port $01 bits 0-2) and GAME, EXROM (cartridge port, low active).
+ * All 32 modes are generated at compile time, RpPetra looks them up whenever one of
+ * the lines changes.
+*/
+
+#ifndef _PLA_HXX
+#define _PLA_HXX
+
+// What is visible instead of RAM for a given PLA mode
+constexpr uint8_t plaBasic   = 0x01; // $A000-$BFFF BASIC
+constexpr uint8_t plaKernal  = 0x02; // $E000-$FFFF KERNAL
+constexpr uint8_t plaCharRom = 0x04; // $D000-$DFFF CHARGEN
+constexpr uint8_t plaIO      = 0x08; // $D000-$DFFF IO
+constexpr uint8_t plaRomL    = 0x10; // $8000-$9FFF cartridge ROML
+constexpr uint8_t plaRomH    = 0x20; // $A000-$BFFF cartridge ROMH ($E000-$FFFF in ultimax mode)
+constexpr uint8_t plaUltimax = 0x40; // $1000-$7FFF and $A000-$CFFF not connected
+
+/**
+ * mode: Bit0 LORAM, Bit1 HIRAM, Bit2 CHAREN, Bit3 GAME, Bit4 EXROM
+ * 
+ * 24-31 - no cartridge, the classic 8 configurations of $01
+ * 8-15  - 8K cartridge (EXROM low), ROML replaces RAM at $8000 if BASIC is visible
+ * 0-7   - 16K cartridge (EXROM and GAME low), ROMH replaces BASIC if HIRAM is set
+ * 16-23 - ultimax (GAME low), ROML at $8000, ROMH at $E000, IO, everything else open
+*/
+constexpr uint8_t PlaConfig(uint8_t mode)
+{
+  bool loram=mode & 0x01;
+  bool hiram=mode & 0x02;
+  bool charen=mode & 0x04;
+  bool game=mode & 0x08;
+  bool exrom=mode & 0x10;
+  uint8_t config=0;
+
+  if (!game && exrom) 
+  {
+    config=plaUltimax | plaRomL | plaRomH | plaIO;
+  }
+  else if (game)
+  {
+    if (loram || hiram)
+    {
+      config=charen ? plaIO : plaCharRom;
+      if (hiram)
+      {
+        config|=plaKernal;
+      }
+      if (hiram && loram)
+      {
+        config|=exrom ? plaBasic : (plaBasic | plaRomL);
+      }
+    }
+  }
+  else // 16K cartridge
+  {
+    if (hiram)
+    {
+      config=plaKernal | plaRomH | (charen ? plaIO : plaCharRom);
+      if (loram)
+      {
+        config|=plaRomL;
+      }
+    }
+    else if (loram && charen)
+    {
+      config=plaIO;
+    }
+  }
+  return config;
+}
+
+struct PlaTable {
+  uint8_t config[32];
+
+  constexpr PlaTable() : config()
+  {
+    for (uint8_t mode=0;mode<32;mode++)
+    {
+      config[mode]=PlaConfig(mode);
+    }
+  }
+};
+
+constexpr PlaTable plaTable;
+
+static_assert(plaTable.config[31]==(plaBasic | plaKernal | plaIO), "Default C-64 configuration ($01=$37)");
+static_assert(plaTable.config[24]==0 && plaTable.config[28]==0, "All RAM");
+
+#endif
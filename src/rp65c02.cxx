@@ -4,11 +4,636 @@
 */
 #include "stdinclude.hxx"
 
+// Between two instructions
+static const CpuUop fetchSequence[2]={uopFetch,uopEnd};
+
 RP65C02::RP65C02(Logging *pLogging)
 {
   m_pLogging = pLogging;
+  m_a=m_x=m_y=m_s=0;
+  m_p=flagU | flagI;
+  m_pc=0;
+  m_opcode=0;
+  m_op=opNone;
+  m_pSequence=fetchSequence;
+  m_step=0;
+  m_uop=uopFetch;
+  m_addr=0;
+  m_baseHi=0;
+  m_pointer=0;
+  m_data=0;
+  m_vector=0xfffc;
+  m_irq=m_nmi=m_nmiEdge=false;
+  m_intSample=m_intSamplePrev=false;
+  m_takeInterrupt=false;
+  m_resetPending=true;
+  m_interrupt=cpuIntNone;
+  m_cycles=0;
+  m_instructions=0;
 }
 
 RP65C02::~RP65C02()
 {
 }
+
+/**
+ * Like the real chip, RESET runs the BRK sequence with the stack writes turned into
+ * reads: 7 cycles, S is decremented by 3, then PC is loaded from $FFFC.
+ */
+void RP65C02::Reset()
+{
+  m_pSequence=fetchSequence;
+  m_step=0;
+  m_resetPending=true;
+  m_takeInterrupt=false;
+  m_nmiEdge=false;
+}
+
+void RP65C02::SetIRQ(bool enable)
+{
+  m_irq=enable;
+}
+
+void RP65C02::SetNMI(bool enable)
+{
+  if (enable && !m_nmi)
+  {
+    m_nmiEdge=true;
+  }
+  m_nmi=enable;
+}
+
+void RP65C02::SetPC(uint16_t pc)
+{
+  m_pc=pc;
+  m_pSequence=fetchSequence;
+  m_step=0;
+}
+
+void RP65C02::Advance()
+{
+  m_step++;
+  if (m_pSequence[m_step]==uopEnd)
+  {
+    Finish();
+  }
+}
+
+// Interrupts are polled in the last cycle of an instruction
+void RP65C02::Finish()
+{
+  m_takeInterrupt=m_intSample;
+  m_pSequence=fetchSequence;
+  m_step=0;
+}
+
+void RP65C02::Adc(uint8_t value)
+{
+  unsigned int carry=m_p & flagC;
+  unsigned int result;
+  if (m_p & flagD)
+  {
+    // NMOS: N, V and Z do not reflect the decimal result
+    result=(m_a & 0x0f)+(value & 0x0f)+carry;
+    if (result>0x09)
+    {
+      result+=0x06;
+    }
+    result=(result & 0x0f)+(m_a & 0xf0)+(value & 0xf0)+(result>0x0f ? 0x10 : 0);
+    SetFlag(flagZ,((m_a+value+carry) & 0xff)==0);
+    SetFlag(flagN,result & 0x80);
+    SetFlag(flagV,((m_a ^ result) & 0x80) && !((m_a ^ value) & 0x80));
+    if ((result & 0x1f0)>0x90)
+    {
+      result+=0x60;
+    }
+    SetFlag(flagC,(result & 0xff0)>0xf0);
+  }
+  else
+  {
+    result=m_a+value+carry;
+    SetNZ(result);
+    SetFlag(flagV,!((m_a ^ value) & 0x80) && ((m_a ^ result) & 0x80));
+    SetFlag(flagC,result>0xff);
+  }
+  m_a=result;
+}
+
+void RP65C02::Sbc(uint8_t value)
+{
+  unsigned int borrow=(m_p & flagC) ? 0 : 1;
+  unsigned int result=m_a-value-borrow;
+  SetNZ(result);
+  SetFlag(flagV,((m_a ^ result) & 0x80) && ((m_a ^ value) & 0x80));
+  if (m_p & flagD)
+  {
+    unsigned int decimal=(m_a & 0x0f)-(value & 0x0f)-borrow;
+    if (decimal & 0x10)
+    {
+      decimal=((decimal-0x06) & 0x0f) | ((m_a & 0xf0)-(value & 0xf0)-0x10);
+    }
+    else
+    {
+      decimal=(decimal & 0x0f) | ((m_a & 0xf0)-(value & 0xf0));
+    }
+    if (decimal & 0x100)
+    {
+      decimal-=0x60;
+    }
+    SetFlag(flagC,result<0x100);
+    m_a=decimal;
+  }
+  else
+  {
+    SetFlag(flagC,result<0x100);
+    m_a=result;
+  }
+}
+
+void RP65C02::Compare(uint8_t reg, uint8_t value)
+{
+  SetNZ(reg-value);
+  SetFlag(flagC,reg>=value);
+}
+
+// Read operations and the second half of the combined read-modify-write opcodes
+void RP65C02::Execute(uint8_t value)
+{
+  switch (m_op)
+  {
+    case opORA: case opSLO:
+      m_a|=value;
+      SetNZ(m_a);
+      break;
+    case opAND: case opRLA:
+      m_a&=value;
+      SetNZ(m_a);
+      break;
+    case opEOR: case opSRE:
+      m_a^=value;
+      SetNZ(m_a);
+      break;
+    case opADC: case opRRA:
+      Adc(value);
+      break;
+    case opSBC: case opISC:
+      Sbc(value);
+      break;
+    case opCMP: case opDCP:
+      Compare(m_a,value);
+      break;
+    case opCPX:
+      Compare(m_x,value);
+      break;
+    case opCPY:
+      Compare(m_y,value);
+      break;
+    case opLDA:
+      m_a=value;
+      SetNZ(m_a);
+      break;
+    case opLDX:
+      m_x=value;
+      SetNZ(m_x);
+      break;
+    case opLDY:
+      m_y=value;
+      SetNZ(m_y);
+      break;
+    case opBIT:
+      SetFlag(flagZ,(m_a & value)==0);
+      m_p=(m_p & ~(flagN | flagV)) | (value & (flagN | flagV));
+      break;
+    case opLAX:
+      m_a=m_x=value;
+      SetNZ(m_a);
+      break;
+    case opLAS:
+      m_a=m_x=m_s=value & m_s;
+      SetNZ(m_a);
+      break;
+    case opANC:
+      m_a&=value;
+      SetNZ(m_a);
+      SetFlag(flagC,m_a & 0x80);
+      break;
+    case opALR:
+      m_a&=value;
+      SetFlag(flagC,m_a & 0x01);
+      m_a>>=1;
+      SetNZ(m_a);
+      break;
+    case opARR:
+    {
+      uint8_t anded=m_a & value;
+      uint8_t result=(anded>>1) | ((m_p & flagC) ? 0x80 : 0);
+      if (m_p & flagD)
+      {
+        SetFlag(flagN,m_p & flagC);
+        SetFlag(flagZ,result==0);
+        SetFlag(flagV,(result ^ anded) & 0x40);
+        if ((anded & 0x0f)+(anded & 0x01)>0x05)
+        {
+          result=(result & 0xf0) | ((result+0x06) & 0x0f);
+        }
+        bool carry=(anded & 0xf0)+(anded & 0x10)>0x50;
+        if (carry)
+        {
+          result=(result & 0x0f) | ((result+0x60) & 0xf0);
+        }
+        SetFlag(flagC,carry);
+      }
+      else
+      {
+        SetNZ(result);
+        SetFlag(flagC,result & 0x40);
+        SetFlag(flagV,(result & 0x40) ^ ((result & 0x20)<<1));
+      }
+      m_a=result;
+      break;
+    }
+    case opANE:
+      // Unstable, $EE is what most C64s show
+      m_a=(m_a | 0xee) & m_x & value;
+      SetNZ(m_a);
+      break;
+    case opLXA:
+      m_a=m_x=(m_a | 0xee) & value;
+      SetNZ(m_a);
+      break;
+    case opSBX:
+    {
+      uint8_t anded=m_a & m_x;
+      SetFlag(flagC,anded>=value);
+      m_x=anded-value;
+      SetNZ(m_x);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// Write operations. SHA, SHX, SHY and TAS AND the value with the high byte of the base address + 1.
+uint8_t RP65C02::StoreValue()
+{
+  switch (m_op)
+  {
+    case opSTA: return m_a;
+    case opSTX: return m_x;
+    case opSTY: return m_y;
+    case opSAX: return m_a & m_x;
+    case opSHA: return m_a & m_x & (m_baseHi+1);
+    case opSHX: return m_x & (m_baseHi+1);
+    case opSHY: return m_y & (m_baseHi+1);
+    case opTAS:
+      m_s=m_a & m_x;
+      return m_s & (m_baseHi+1);
+    default:
+      return 0;
+  }
+}
+
+uint8_t RP65C02::Modify(uint8_t value)
+{
+  uint8_t carry=m_p & flagC;
+  switch (m_op)
+  {
+    case opASL: case opSLO: case opASLA:
+      SetFlag(flagC,value & 0x80);
+      value<<=1;
+      break;
+    case opROL: case opRLA: case opROLA:
+      SetFlag(flagC,value & 0x80);
+      value=(value<<1) | carry;
+      break;
+    case opLSR: case opSRE: case opLSRA:
+      SetFlag(flagC,value & 0x01);
+      value>>=1;
+      break;
+    case opROR: case opRRA: case opRORA:
+      SetFlag(flagC,value & 0x01);
+      value=(value>>1) | (carry<<7);
+      break;
+    case opDEC: case opDCP:
+      value--;
+      break;
+    case opINC: case opISC:
+      value++;
+      break;
+    default:
+      break;
+  }
+  SetNZ(value);
+  return value;
+}
+
+void RP65C02::ExecuteImplied()
+{
+  switch (m_op)
+  {
+    case opTXA: m_a=m_x; SetNZ(m_a); break;
+    case opTYA: m_a=m_y; SetNZ(m_a); break;
+    case opTAX: m_x=m_a; SetNZ(m_x); break;
+    case opTAY: m_y=m_a; SetNZ(m_y); break;
+    case opTSX: m_x=m_s; SetNZ(m_x); break;
+    case opTXS: m_s=m_x; break;
+    case opDEX: m_x--; SetNZ(m_x); break;
+    case opDEY: m_y--; SetNZ(m_y); break;
+    case opINX: m_x++; SetNZ(m_x); break;
+    case opINY: m_y++; SetNZ(m_y); break;
+    case opCLC: m_p&=~flagC; break;
+    case opSEC: m_p|=flagC; break;
+    case opCLI: m_p&=~flagI; break;
+    case opSEI: m_p|=flagI; break;
+    case opCLV: m_p&=~flagV; break;
+    case opCLD: m_p&=~flagD; break;
+    case opSED: m_p|=flagD; break;
+    case opASLA: case opROLA: case opLSRA: case opRORA:
+      m_a=Modify(m_a);
+      break;
+    default:
+      break;
+  }
+}
+
+bool RP65C02::IsBranchTaken()
+{
+  switch (m_op)
+  {
+    case opBPL: return !(m_p & flagN);
+    case opBMI: return m_p & flagN;
+    case opBVC: return !(m_p & flagV);
+    case opBVS: return m_p & flagV;
+    case opBCC: return !(m_p & flagC);
+    case opBCS: return m_p & flagC;
+    case opBNE: return !(m_p & flagZ);
+    case opBEQ: return m_p & flagZ;
+    default:    return false;
+  }
+}
+
+/**
+ * First half of a bus cycle: put address and R/W on the bus. Write cycles are complete
+ * here, read cycles are completed by Latch().
+ */
+void __not_in_flash_func(RP65C02::NextCycle)(uint16_t *pAddr, bool *pReadNotWrite, uint8_t *pData)
+{
+  m_cycles++;
+  m_intSamplePrev=m_intSample;
+  m_intSample=m_nmiEdge || (m_irq && !(m_p & flagI));
+  m_uop=m_pSequence[m_step];
+  *pReadNotWrite=true;
+  switch (m_uop)
+  {
+    case uopZeroPageX:
+      *pAddr=m_addr;
+      m_addr=(uint8_t)(m_addr+m_x);
+      break;
+    case uopZeroPageY:
+      *pAddr=m_addr;
+      m_addr=(uint8_t)(m_addr+m_y);
+      break;
+    case uopPointerX:
+      *pAddr=m_pointer;
+      m_pointer+=m_x;
+      break;
+    case uopPointerLo:
+      *pAddr=m_pointer;
+      break;
+    case uopPointerHi:
+      *pAddr=(uint8_t)(m_pointer+1);
+      break;
+    case uopIndexXRead: case uopIndexXDummy:
+    case uopIndexYRead: case uopIndexYDummy:
+    {
+      uint8_t index=(m_uop==uopIndexXRead || m_uop==uopIndexXDummy) ? m_x : m_y;
+      m_baseHi=m_addr>>8;
+      *pAddr=(m_addr & 0xff00) | (uint8_t)(m_addr+index);
+      m_addr+=index;
+      break;
+    }
+    case uopRead: case uopRmwRead: case uopJmpIndLo:
+      *pAddr=m_addr;
+      break;
+    case uopJmpIndHi:
+      *pAddr=(m_addr & 0xff00) | (uint8_t)(m_addr+1);
+      break;
+    case uopBranchFix:
+      *pAddr=(m_pc & 0xff00) | (m_addr & 0x00ff);
+      break;
+    case uopStackDummy:
+      *pAddr=0x100 | m_s;
+      break;
+    case uopPullA: case uopPullPlp: case uopPullP: case uopPullPCL: case uopPullPCH:
+      m_s++;
+      *pAddr=0x100 | m_s;
+      break;
+    case uopVectorLo:
+      *pAddr=m_vector;
+      break;
+    case uopVectorHi:
+      *pAddr=m_vector+1;
+      break;
+    case uopJam:
+      *pAddr=0xffff;
+      break;
+    case uopWrite:
+      *pData=StoreValue();
+      if (m_op>=opSHA && m_op<=opTAS && (m_addr>>8)!=m_baseHi)
+      {
+        // Page crossed: the value replaces the high byte of the address
+        m_addr=(*pData<<8) | (m_addr & 0xff);
+      }
+      *pAddr=m_addr;
+      *pReadNotWrite=false;
+      Advance();
+      break;
+    case uopRmwDummy:
+      *pAddr=m_addr;
+      *pData=m_data;
+      *pReadNotWrite=false;
+      m_data=Modify(m_data);
+      Advance();
+      break;
+    case uopRmwWrite:
+      *pAddr=m_addr;
+      *pData=m_data;
+      *pReadNotWrite=false;
+      Execute(m_data);
+      Advance();
+      break;
+    case uopPushPCH: case uopPushPCL: case uopPushP:
+      *pAddr=0x100 | m_s;
+      m_s--;
+      if (m_uop==uopPushP)
+      {
+        // An NMI arriving until here hijacks BRK and IRQ
+        if (m_interrupt==cpuIntReset)
+        {
+          m_vector=0xfffc;
+        }
+        else if (m_nmiEdge)
+        {
+          m_nmiEdge=false;
+          m_vector=0xfffa;
+        }
+        else
+        {
+          m_vector=0xfffe;
+        }
+      }
+      if (m_interrupt!=cpuIntReset)
+      {
+        *pData=m_uop==uopPushPCH ? (m_pc>>8) : (m_uop==uopPushPCL ? (uint8_t)m_pc : (m_p | flagU | (m_interrupt==cpuIntNone ? flagB : 0)));
+        *pReadNotWrite=false;
+        Advance();
+      }
+      break;
+    case uopPushA: case uopPushPhp:
+      *pAddr=0x100 | m_s;
+      m_s--;
+      *pData=m_uop==uopPushA ? m_a : (m_p | flagU | flagB);
+      *pReadNotWrite=false;
+      Advance();
+      break;
+    default:
+      // uopFetch, uopImplied, uopImmediate, uopDummyPC, uopAddrLo, uopAddrHi, uopBranch,
+      // uopBranchTaken, uopJmpAbs, uopRtsInc, uopJsrAddrHi, uopBrk
+      *pAddr=m_pc;
+      break;
+  }
+}
+
+// Second half of a read cycle
+void __not_in_flash_func(RP65C02::Latch)(uint8_t data)
+{
+  switch (m_uop)
+  {
+    case uopFetch:
+      m_instructions++;
+      if (m_resetPending || m_takeInterrupt)
+      {
+        m_interrupt=m_resetPending ? cpuIntReset : cpuIntIrq;
+        m_resetPending=false;
+        m_takeInterrupt=false;
+        m_opcode=0x00;
+      }
+      else
+      {
+        m_interrupt=cpuIntNone;
+        m_opcode=data;
+        m_pc++;
+      }
+      m_op=cpuDecodeTable.op[m_opcode];
+      m_pSequence=cpuDecodeTable.sequence[m_opcode].uop;
+      m_step=0;
+      return;
+    case uopImplied:
+      ExecuteImplied();
+      break;
+    case uopImmediate:
+      m_pc++;
+      Execute(data);
+      break;
+    case uopAddrLo:
+      m_pc++;
+      m_addr=data;
+      m_pointer=data;
+      break;
+    case uopAddrHi:
+      m_pc++;
+      m_addr|=data<<8;
+      break;
+    case uopPointerLo:
+      m_addr=data;
+      break;
+    case uopPointerHi:
+      m_addr|=data<<8;
+      break;
+    case uopIndexXRead: case uopIndexYRead:
+      if ((m_addr>>8)==m_baseHi)
+      {
+        Execute(data);
+        Finish();
+        return;
+      }
+      break;
+    case uopRead:
+      Execute(data);
+      break;
+    case uopRmwRead:
+      m_data=data;
+      break;
+    case uopBranch:
+      m_pc++;
+      if (!IsBranchTaken())
+      {
+        Finish();
+        return;
+      }
+      m_addr=m_pc+(int8_t)data;
+      break;
+    case uopBranchTaken:
+      if ((m_addr & 0xff00)==(m_pc & 0xff00))
+      {
+        m_pc=m_addr;
+        Finish();
+        // Without page crossing the interrupt is polled one cycle earlier
+        m_takeInterrupt=m_intSamplePrev;
+        return;
+      }
+      break;
+    case uopBranchFix:
+      m_pc=m_addr;
+      break;
+    case uopJmpAbs: case uopJsrAddrHi:
+      m_pc=(data<<8) | (m_addr & 0xff);
+      break;
+    case uopJmpIndLo:
+      m_data=data;
+      break;
+    case uopJmpIndHi:
+      m_pc=(data<<8) | m_data;
+      break;
+    case uopPushPCH: case uopPushPCL: case uopPushP:
+      // RESET, stack writes are reads
+      break;
+    case uopPullA:
+      m_a=data;
+      SetNZ(m_a);
+      break;
+    case uopPullPlp: case uopPullP:
+      m_p=(data & ~flagB) | flagU;
+      break;
+    case uopPullPCL:
+      m_pc=(m_pc & 0xff00) | data;
+      break;
+    case uopPullPCH:
+      m_pc=(m_pc & 0x00ff) | (data<<8);
+      break;
+    case uopRtsInc:
+      m_pc++;
+      break;
+    case uopBrk:
+      if (m_interrupt==cpuIntNone)
+      {
+        m_pc++;
+      }
+      break;
+    case uopVectorLo:
+      m_pc=(m_pc & 0xff00) | data;
+      m_p|=flagI;
+      break;
+    case uopVectorHi:
+      m_pc=(m_pc & 0x00ff) | (data<<8);
+      break;
+    case uopDummyPC: case uopZeroPageX: case uopZeroPageY: case uopPointerX:
+    case uopIndexXDummy: case uopIndexYDummy: case uopStackDummy:
+      break;
+    default:
+      // uopJam and write cycles
+      return;
+  }
+  Advance();
+}
@@ -37,6 +37,8 @@ typedef enum {
 
 // OK #define DELAY_FACTOR_TRANSCEIVER() asm volatile("nop\nnop\nnop\nnop\n");
 #define DELAY_FACTOR_TRANSCEIVER() asm volatile("nop\nnop\nnop\nnop\n");
+// Minimum PHI2 low phase, the VIC no longer runs while PHI2 is low
+#define DELAY_FACTOR_PHI2_LOW() asm volatile("nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop\nnop\nnop\nnop\nnop\n");
 
 typedef enum
 {
@@ -45,14 +47,91 @@ typedef enum
 
 } Direction;
 
-class RP65C02 {
+// Processor status
+constexpr uint8_t flagC = 0x01;
+constexpr uint8_t flagZ = 0x02;
+constexpr uint8_t flagI = 0x04;
+constexpr uint8_t flagD = 0x08;
+constexpr uint8_t flagB = 0x10;
+constexpr uint8_t flagU = 0x20;
+constexpr uint8_t flagV = 0x40;
+constexpr uint8_t flagN = 0x80;
+
+// Why the BRK sequence is running
+typedef enum {
+  cpuIntNone=0, // BRK instruction
+  cpuIntIrq,    // IRQ or NMI
+  cpuIntReset
+} CpuInterrupt;
+
+/**
+ * On the board the 65C02 is real, RpPetra only sees its bus cycles. For the host build
+ * (see hostBus.hxx) this class is a software NMOS 6510 instead: one bus cycle per
+ * NextCycle(), decoded by the tables in opcodes6510.hxx, undocumented opcodes included.
+ * The CPU port $00/$01 is handled by RpPetra, as on the board.
+ */
+class RP65C02 : public HostCpu {
 
   private:
     class Logging *m_pLogging;
+    // Registers
+    uint8_t m_a;
+    uint8_t m_x;
+    uint8_t m_y;
+    uint8_t m_s;
+    uint8_t m_p;
+    uint16_t m_pc;
+    // Instruction in progress
+    uint8_t m_opcode;
+    CpuOp m_op;
+    const CpuUop *m_pSequence;
+    uint8_t m_step;
+    CpuUop m_uop;        // bus cycle waiting for Latch()
+    uint16_t m_addr;     // effective address
+    uint8_t m_baseHi;    // high byte before indexing
+    uint8_t m_pointer;   // zero page pointer, (zp,X) and (zp),Y
+    uint8_t m_data;      // read-modify-write value, branch offset, JMP (ind) low byte
+    uint16_t m_vector;
+    // Interrupts
+    bool m_irq;
+    bool m_nmiEdge;
+    bool m_nmi;
+    bool m_intSample;      // IRQ/NMI pending, sampled at the start of this cycle
+    bool m_intSamplePrev;  // ... and of the previous one
+    bool m_takeInterrupt;
+    bool m_resetPending;
+    CpuInterrupt m_interrupt;
+    // Statistics
+    uint64_t m_cycles;
+    uint64_t m_instructions;
+
+    inline void SetNZ(uint8_t value) { m_p=(m_p & ~(flagN | flagZ)) | (value & flagN) | (value ? 0 : flagZ);};
+    inline void SetFlag(uint8_t flag, bool set) { m_p=set ? (m_p | flag) : (m_p & ~flag);};
+    void Advance();
+    void Finish();
+    void Adc(uint8_t value);
+    void Sbc(uint8_t value);
+    void Compare(uint8_t reg, uint8_t value);
+    void Execute(uint8_t value);
+    uint8_t StoreValue();
+    uint8_t Modify(uint8_t value);
+    void ExecuteImplied();
+    bool IsBranchTaken();
 
   public:
     RP65C02(Logging *pLogging);
     virtual ~RP65C02();
+    // HostCpu
+    void Reset();
+    void SetIRQ(bool enable);
+    void SetNMI(bool enable);
+    void Latch(uint8_t data);
+    void NextCycle(uint16_t *pAddr, bool *pReadNotWrite, uint8_t *pData);
+    // Abandons the instruction in progress, the next cycle fetches the opcode at pc.
+    void SetPC(uint16_t pc);
+    inline uint16_t GetPC() { return m_pc;};
+    inline uint64_t GetCycles() { return m_cycles;};
+    inline uint64_t GetInstructions() { return m_instructions;};
 };
 
 #endif
\ No newline at end of file
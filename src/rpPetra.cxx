@@ -33,6 +33,15 @@ RpPetra::RpPetra(Logging *pLogging, RP65C02 *pCPU)
 {
     m_pLog=pLogging;
     m_pCPU=pCPU;
+    m_currentCycle=0;
+    m_lineStartCycle=0;
+    memset(m_stallMask,0,sizeof(m_stallMask));
+    m_stalling=false;
+    m_cyclesPerLine=0;
+    m_writeStamp=1;
+    memset(m_pageWritten,0,sizeof(m_pageWritten));
+    m_pScheduler = new Scheduler();
+    m_pGovernor = new Governor(pLogging,m_pScheduler);
     m_pCIA1 = new CIA1(pLogging,this);
     m_pCIA2 = new CIA2(pLogging,this);
     m_pVICII= new VIC6569(pLogging,this);
@@ -42,6 +51,12 @@ RpPetra::RpPetra(Logging *pLogging, RP65C02 *pCPU)
     m_pJoystickB=nullptr;
     m_pRAM=(uint8_t *)calloc(65536,sizeof(uint8_t));
     m_pRAM[1]=0x37;
+  memset(m_openBusPage,0xff,sizeof(m_openBusPage));
+  m_pRomL=nullptr;
+  m_pRomH=nullptr;
+  m_game=true; // No cartridge
+  m_exrom=true;
+  m_plaInput=0xff;
 
 #ifdef _MONITOR_CARTRIDGE
     // SYS 49152
@@ -98,7 +113,19 @@ uint8_t rasterIrq[]={ 0x78,0xA9,0x22,0x8D,0x14,0x03,0xA9,0x40,
 #endif
 
 #endif
+#ifndef _HOST
   m_pVideoOut=new VideoOut(pLogging, this, m_pVICII->GetFrameBuffer());
+#endif
+  m_pBus=new CpuBus(pLogging);
+  m_pScheduler->Register(EventAutoload,Autoload,this);
+#ifdef _BUS_TRACE
+  m_pBusTrace=new BusTrace();
+#ifndef _HOST
+  m_pBusTrace->InitUart();
+  m_pScheduler->Register(EventBusTrace,BusTrace::Drain,m_pBusTrace);
+  m_pBusTrace->Start();
+#endif
+#endif
   Reset();
 }
 
@@ -107,6 +134,7 @@ uint8_t rasterIrq[]={ 0x78,0xA9,0x22,0x8D,0x14,0x03,0xA9,0x40,
   and were written by Paul Robson (paul@robsons.org.uk) and Harry Fairhead.
 */
 
+#ifndef _HOST
 void pwm_interrupt_handler() {
   static uint16_t buffer[16];
   pwm_clear_irq(pwm_gpio_to_slice_num(SOUND_PIN));
@@ -151,6 +179,7 @@ void SNDInitialise(void) {
     pwm_set_gpio_level(SOUND_PIN, 0);
 #endif    
 }
+#endif
 
 
 RpPetra::~RpPetra()
@@ -159,27 +188,37 @@ RpPetra::~RpPetra()
 
 void RpPetra::Reset()
 {
-  // Activate RP2040 pins used for the CPU communication
-  gpio_init_mask(pioMask_CPU);   
-  gpio_set_dir(CLK,true); // CLK is always an output signal
-  gpio_set_dir(RESET,true); // RESET is always an output signal
-  gpio_set_dir(IRQ,true); // IRQ is always an output signal
-  gpio_set_dir(NMI,true); // NMI is always an output signal
-  gpio_set_dir(RW,false);  // RW pin is always input from 6502
-  gpio_set_dir_out_masked(pioMaskOE_U5_U6_U7);  // Set OE pins to output 
-  gpio_set_dir_in_masked(pioMaskData_U5_U6_U7); // Switch all pio pins from transceiver data lines to input
-  SignalIRQ(false);
-  SignalNMI(false);
-  DisableBus();
+  m_pBus->Init();
   m_pVICII->Reset();  
   m_pCIA1->Reset();  
   m_pCIA2->Reset();  
+#ifndef _HOST
   m_pVideoOut->Reset();
+#endif
+  UpdateMemoryMap();
+  m_pScheduler->Schedule(EventAutoload,m_currentCycle+AUTOLOAD_CYCLE);
+  // The VIC model sets the system clock the governor paces and the SID plays at
+  const VicTiming *pTiming=m_pVICII->GetTiming();
+  m_pGovernor->SetClock(pTiming->clockHz);
+  m_pGovernor->Reset(m_currentCycle);
+#if defined(_BUS_TRACE) && !defined(_HOST)
+  m_pScheduler->Schedule(EventBusTrace,m_currentCycle+BUS_TRACE_DRAIN_CYCLES,BUS_TRACE_DRAIN_CYCLES);
+#endif
   ResetCPU();
 #ifdef _SID  
+  SIDSetVicType(pTiming->pName);
   SIDReset(0);
+#ifndef _HOST
   ::SNDInitialise();
 #endif
+#endif
+}
+
+// Switches the VIC timing, the system clock and the SID clock and resets the machine
+void RpPetra::SetVicModel(VicModel model)
+{
+  m_pVICII->SetModel(model);
+  Reset();
 }
 
 // Note: According to the WDC the IRQB low level should be held until the interrupt handler clears 
@@ -189,8 +228,7 @@ void RpPetra::SignalIRQ(bool enable)
   static uint16_t activity=0;
   if (enable && ++activity%1000==0) puts("*");
 
-  if (enable) gpio_put(IRQ, LOW); // IRQ is low active so reset is active now
-  else gpio_put(IRQ, HIGH); // IRQ is low active so reset is active now
+  m_pBus->SignalIRQ(enable);
 }
 
 // WDC: A negative transition on the Non-Maskable Interrupt (NMIB) input initiates an interrupt sequence after the
@@ -200,378 +238,269 @@ void RpPetra::SignalNMI(bool enable)
   static uint16_t activity=0;
   if (enable && ++activity%1000==0) puts("#");
 
-  if (enable) gpio_put(NMI, LOW); // IRQ is low active so reset is active now
-  else gpio_put(NMI, HIGH); // IRQ is low active so reset is active now
+  m_pBus->SignalNMI(enable);
 }
 
 // Reset logic for 65C02 
 void RpPetra::ResetCPU()
 {
-  // According to the WDC databook, we need to keep RESB low for at least two
-  // cycles. However, for the 65C02 silicon used in the neo6502 this is not necessary. 
-  // A little delay would do without requiring any PHI2 (CLK).
-  gpio_put(RESET, LOW); // RESET is low active so reset is active now
-  ClockCPU(2);
-  gpio_put(RESET, HIGH);
-  // We now have to run six (in fact 7) clock cycles before any data from CPU is valid. Source: WDC 65C02 databook.
-  ClockCPU(7);
-}
-
-// Triggers the PHI2 the number of times specified gracefully. It looks like the
-// 65C02 requires some time during RESET not relying to CLK.
-void RpPetra::ClockCPU(int counter)
-{
-  for (int i=0;i<counter;i++)
-  {
-    PHI2(LOW);
-    sleep_ms(10);
-    PHI2(HIGH);
-    sleep_ms(10);
-  }
-}
-
-/** Part of the PLA... 
- * 
- * Bit0: LoRam - 1: A000-BFFF ROM, 0: RAM
- * Bit1: HiRam - 1: E000-FFFF ROM, 0: RAM
- * Bit2: CharEn- 1: D000-DFFF CHAREN, 0: RAM/IO
-
- * 0- BASIC OFF , KERNAL OFF, RAM
- * 1- BASIC OFF, KERNAL OFF, CHARGEN
- * 2- BASIC OFF, KERNAL ON, CHARGEN
- * 3- BASIC ON, KERNAL ON, CHARGEN
- * 4- BASIC OFF, KERNAL OFF, RAM
- * 5- BASIC OFF, KERNAL OFF, IO 
- * 6- BASIC OFF, KERNAL ON, IO
- * 7- BASIC ON, KERNAL ON, IO
- * 8- BASIC OFF, KERNAL OFF, RAM
- * 9- BASIC OFF, KERNAL OFF, CHARGEN
- * 10- BASIC OFF, KERNAL ON, CHARGEN
- * 11- BASIC ON, KERNAL ON, CHARGEN
- * 12- BASIC OFF, KERNAL OFF, RAM
- * 13- BASIC OFF, KERNAL OFF, IO
- * 14- BASIC OFF, KERNAL ON, IO 
- * 15- BASIC ON, KERNAL ON, IO
- * 
-*/
-
-void __not_in_flash_func (RpPetra::CalcPLA)(uint8_t cpuPort)
-{
-  switch (cpuPort & 0x07)
-  {
-    case 0:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=false;
-    break;
-    case 1:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    
-    case 2:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    case 3:
-      m_isBasicRomVisible=true;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    case 4:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=false;
-    break;
-    case 5:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;
-    break;
-    case 6:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;
-    break;
-    case 7:
-      m_isBasicRomVisible=true;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;
-    break;
-    case 8:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=false;
-    break;
-    case 9:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    case 10:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    case 11:
-      m_isBasicRomVisible=true;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=false;
-      m_isCharRomVisible=true;
-    break;
-    case 12:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=false;
-      m_isCharRomVisible=false;
-    break;
-    case 13:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=false;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;
-    break;
-    case 14:
-      m_isBasicRomVisible=false;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;
-    break;
-    case 15:
-      m_isBasicRomVisible=true;
-      m_isKernalRomVisible=true;
-      m_isIOVisible=true;
-      m_isCharRomVisible=false;  
-    break;
-  }
+  m_pBus->ResetCPU();
 }
 
 // In this design we use Petra's CLK == 65C02 PHI2. We may later decide
 // to use some kind of interleave factor x.
-void __not_in_flash_func (RpPetra::Clk)(SYSTEMSTATE *pSystemState, uint64_t totalCycles)
+// Returns false if the VIC has the bus (badline, sprite DMA): the 65C02 gets no PHI2 edge,
+// it is fully static and just waits, the cycle is free for housekeeping.
+bool __not_in_flash_func (RpPetra::Clk)(SYSTEMSTATE *pSystemState, uint64_t totalCycles)
 {
   static uint16_t addr;
   static uint8_t byte; 
   
-  PHI2(LOW);
-  m_pVICII->Clk();
-  gpio_set_dir_in_masked(pioMaskData_U5_U6_U7); // set the datalines to input (seen from RP2040 side)   
-  PHI2(HIGH);
-  m_pCIA1->Clk();
-  m_pCIA2->Clk();
-  ReadCPUSignals(pSystemState);      
+  m_currentCycle=totalCycles;
+  if (m_stalling)
+  {
+    uint64_t lineCycle=totalCycles-m_lineStartCycle;
+    if (lineCycle<m_cyclesPerLine && ((m_stallMask[lineCycle >> 6] >> (lineCycle & 63)) & 1))
+    {
+      return false;
+    }
+  }
+  m_pBus->NextCycle(&pSystemState->cpuState);
  
   addr=pSystemState->cpuState.a0a15;  
   byte=pSystemState->cpuState.d0d7;  
-  
-  CalcPLA(m_pRAM[1]);
-#ifdef _ELITE
-  if (totalCycles==2300000)
+
+  if (pSystemState->cpuState.readNotWrite)   // READ access
   {
-    memcpy(&m_pRAM[0x0801],elite_rom,sizeof(elite_rom)); // 16384
+    const uint8_t *pPage=m_readPage[addr >> 8];
+    byte=pPage!=nullptr ? pPage[addr & 0xff] : ReadIO(addr,totalCycles);
+    m_pBus->WriteDataBus(byte);
   }
-#endif
-#ifdef _MERCENARY
-  if (totalCycles==2300000)
+  else
   {
-    memcpy(&m_pRAM[0x0801],mercenary_rom,sizeof(mercenary_rom)); // 2065
+    uint8_t *pPage=m_writePage[addr >> 8];
+    if (pPage!=nullptr)
+    {
+      pPage[addr & 0xff]=byte;
+      m_pageWritten[addr >> 8]=m_writeStamp;
+      if (addr<2) // CPU port, banking may have changed
+      {
+        UpdateMemoryMap();
+      }
+    }
+    else
+    {
+      WriteIO(addr,byte);
+    }
   }
+#ifdef _BUS_TRACE
+  m_pBusTrace->Record(totalCycles,addr,byte,pSystemState->cpuState.readNotWrite);
+#endif
+  return true;
+}
+
+// Scheduler event: loads the program selected at compile time once the KERNAL has
+// finished its RAM test and BASIC is ready.
+void RpPetra::Autoload(void *pContext, uint64_t cycle)
+{
+  [[maybe_unused]] RpPetra *pGlue=(RpPetra *)pContext;
+#ifdef _ELITE
+  memcpy(&pGlue->m_pRAM[0x0801],elite_rom,sizeof(elite_rom)); // 16384
+#endif
+#ifdef _MERCENARY
+  memcpy(&pGlue->m_pRAM[0x0801],mercenary_rom,sizeof(mercenary_rom)); // 2065
 #endif
 #ifdef _PULSAR7
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],pulsar7_rom,sizeof(pulsar7_rom)); // 2065
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],pulsar7_rom,sizeof(pulsar7_rom)); // 2065
 #endif
 #ifdef _FAIRLIGHT
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],fairlight_rom,sizeof(fairlight_rom)); // 2066
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],fairlight_rom,sizeof(fairlight_rom)); // 2066
 #endif
 #ifdef _NIGHTSHADE
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],nightshade_rom,sizeof(nightshade_rom)); // 2080
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],nightshade_rom,sizeof(nightshade_rom)); // 2080
 #endif
 
 #ifdef _LOM
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],lom_rom,sizeof(lom_rom)); 
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],lom_rom,sizeof(lom_rom)); 
 #endif
 
 #ifdef _LOMII
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],lomii_rom,sizeof(lomii_rom)); 
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],lomii_rom,sizeof(lomii_rom)); 
 #endif
 
 #ifdef _HOBBIT
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],hobbit_rom,sizeof(hobbit_rom)); 
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],hobbit_rom,sizeof(hobbit_rom)); 
 #endif
 #ifdef _CMASTER
-  if (totalCycles==2300000)
-  {
-    memcpy(&m_pRAM[0x0801],cmaster_rom,sizeof(cmaster_rom)); 
-  }
+  memcpy(&pGlue->m_pRAM[0x0801],cmaster_rom,sizeof(cmaster_rom)); 
 #endif
 #ifdef _COLOSSUS
-  if (totalCycles==2300000)
+  memcpy(&pGlue->m_pRAM[0x0801],colossus_rom,sizeof(colossus_rom)); 
+#endif
+  pGlue->m_pVICII->InvalidateLines();
+}
+
+/**
+ * Rebuilds the read and write page tables from the PLA lines. Only called if the
+ * CPU port ($00/$01) or the cartridge lines change, so a RAM/ROM access in Clk()
+ * is a single table lookup. Nothing is done if the lines are the same as before,
+ * e.g. a write to $01 that leaves the bits configured as outputs as they were.
+ * Writes to ROM always end up in the RAM below. Color RAM and $DE00-$DFFF are
+ * mapped directly, only VIC, SID and the CIAs need a handler (nullptr entry).
+ */
+void __not_in_flash_func (RpPetra::UpdateMemoryMap)()
+{
+  // CPU port bits configured as input ($00) are pulled up
+  uint8_t cpuPort=(m_pRAM[1] | ~m_pRAM[0]) & 0x07;
+  uint8_t plaInput=(m_exrom ? 0x10 : 0) | (m_game ? 0x08 : 0) | cpuPort;
+  if (plaInput==m_plaInput)
   {
-    memcpy(&m_pRAM[0x0801],colossus_rom,sizeof(colossus_rom)); 
+    return;
   }
-#endif
+  m_plaInput=plaInput;
+  m_plaConfig=plaTable.config[plaInput];
 
-  if (addr<0xd000 || addr>0xdfff) 
+  for (int page=0;page<256;page++)
   {
-    // No memory mapped access 
-    if (pSystemState->cpuState.readNotWrite)   // READ access
-    {  
-      if (addr>0x9fff && addr<0xc000)
-      {
-        if (IsBasicRomVisible())
-        {
-          WriteDataBus(basic_rom[addr-0xa000]);
-        }
-        else
-        {
-          WriteDataBus(m_pRAM[addr]);
-        }
-      }
-      else if (addr>0xdfff)
-      {
-        if (IsKernalRomVisible())
-        {
-          WriteDataBus(kernal_rom[addr-0xe000]);
-        }
-        else
-        {
-          WriteDataBus(m_pRAM[addr]);
-        }
-      }
-      else
+    m_readPage[page]=&m_pRAM[page << 8];
+    m_writePage[page]=&m_pRAM[page << 8];
+  }
+  if (m_plaConfig & plaUltimax)
+  {
+    for (int page=0x10;page<0xd0;page++)
+    {
+      if (page<0x80 || page>=0xa0)
       {
-        WriteDataBus(m_pRAM[addr]);
+        m_readPage[page]=m_openBusPage;
+        m_writePage[page]=m_unmappedPage;
       }
     }
-    else 
+  }
+  if (IsBasicRomVisible())
+  {
+    for (int page=0xa0;page<0xc0;page++)
     {
-      m_pRAM[addr]=byte;
+      m_readPage[page]=&basic_rom[(page-0xa0) << 8];
     }
   }
-  else
+  if ((m_plaConfig & plaRomL) && m_pRomL!=nullptr)
   {
-    // memory mapped io area
-    if (IsIOVisible()) // IO or CHARGEN or RAM?
+    for (int page=0x80;page<0xa0;page++)
     {
-      // VICII 6569
-      if (addr>0xcfff && addr<0xd400) // d02e) 
-      {
-        if (pSystemState->cpuState.readNotWrite) {   // READ access
-          WriteDataBus(m_pVICII->m_registerSetRead[((addr-0xd000) % 64)]);
-        }
-        else {
-          m_pVICII->WriteRegister(((addr-0xd000) % 64),byte);
-        }       
-      }
-      // SID6581/6582/8580
-      else if (addr>0xd3ff && addr<0xd800) 
-      {
-#ifndef _NO_SID      
-        
-        if (pSystemState->cpuState.readNotWrite) {   // READ access
-          sid_read((uint32_t)((addr-0xd400) % 0x20), (cycle_t)totalCycles);
-        }       
-        else {
-          //static uint16_t sidActivity=0;
-          //if (sidActivity++>0 && sidActivity%100==0)  puts("§");
-          sid_write((uint32_t)((addr-0xd400) % 0x20),byte);
-        }
-#endif
-      } 
-      else if (addr>0xd7ff && addr<0xdc00) // Colorram
-      {
-        if (pSystemState->cpuState.readNotWrite) {   // READ access in colorram
-          WriteDataBus(m_pColorRam[addr-0xd800]);
-        }
-        else // write to colorram
-        {
-          m_pColorRam[addr-0xd800]=byte;
-        }
-      }
-      else if (addr>0xdbff && addr<0xdd00) // CIA-1
-      {   
-        if (pSystemState->cpuState.readNotWrite) {   // READ access
-          // CIA addresses are mirrored every 16 byte until dcff.          
-          WriteDataBus(m_pCIA1->ReadRegister((addr-0xdc00) % 16));
-        }
-        else {
-          m_pCIA1->WriteRegister((addr-0xdc00) % 16, byte);
-        }
-      }
-      else if (addr>0xdcff && addr<0xde00) // CIA-2
-      {
-        if (pSystemState->cpuState.readNotWrite) {   // READ access
-          WriteDataBus(m_pCIA2->ReadRegister((addr-0xdd00) % 16));
-        }
-        else {
-          m_pCIA2->WriteRegister((addr-0xdd00) % 16, byte);
-        }
-      }
-      else // de00-dfff io, should normally be not accessible...
-      {
-        if (pSystemState->cpuState.readNotWrite) {   // READ access
-          WriteDataBus(m_pRAM[addr]);
-        }
-        else {
-          m_pRAM[addr]=byte;
-        }
-      }
+      m_readPage[page]=&m_pRomL[(page-0x80) << 8];
     }
-    else if (IsCharRomVisible()) 
+  }
+  if ((m_plaConfig & plaRomH) && m_pRomH!=nullptr)
+  {
+    uint8_t romHStart=(m_plaConfig & plaUltimax) ? 0xe0 : 0xa0;
+    for (int page=romHStart;page<romHStart+0x20;page++)
     {
-      if (pSystemState->cpuState.readNotWrite) {   // READ access
-        WriteDataBus(chargen_rom[addr-0xd000]);
-      }
-      else // write to RAM
-      {
-        m_pRAM[addr]=byte;
-      }
+      m_readPage[page]=&m_pRomH[(page-romHStart) << 8];
     }
-    else  // plain RAM in io area
+  }
+  if (IsKernalRomVisible())
+  {
+    for (int page=0xe0;page<0x100;page++)
     {
-      if (pSystemState->cpuState.readNotWrite)  // READ 
-      {
-        WriteDataBus(m_pRAM[addr]);
-      }
-      else
-      {
-        m_pRAM[addr]=byte;
-      }
+      m_readPage[page]=&kernal_rom[(page-0xe0) << 8];
+    }
+  }
+  if (IsIOVisible())
+  {
+    for (int page=0xd0;page<0xd8;page++) // VIC, SID
+    {
+      m_readPage[page]=nullptr;
+      m_writePage[page]=nullptr;
+    }
+    for (int page=0xd8;page<0xdc;page++) // Colorram
+    {
+      m_readPage[page]=&m_pColorRam[(page-0xd8) << 8];
+      m_writePage[page]=&m_pColorRam[(page-0xd8) << 8];
+    }
+    for (int page=0xdc;page<0xde;page++) // CIA-1, CIA-2
+    {
+      m_readPage[page]=nullptr;
+      m_writePage[page]=nullptr;
+    }
+    // de00-dfff io, should normally be not accessible... stays RAM
+  }
+  else if (IsCharRomVisible()) 
+  {
+    for (int page=0xd0;page<0xe0;page++)
+    {
+      m_readPage[page]=&chargen_rom[(page-0xd0) << 8];
     }
   }
 }
 
+// Cartridge port. ROML is mapped to $8000, ROMH to $A000 ($E000 in ultimax mode). 
+// GAME and EXROM are low active, pass true for both if there is no cartridge.
+void RpPetra::SetCartridge(const uint8_t *pRomL, const uint8_t *pRomH, bool game, bool exrom)
+{
+  m_pRomL=pRomL;
+  m_pRomH=pRomH;
+  m_game=game;
+  m_exrom=exrom;
+  m_plaInput=0xff; // the ROMs may have changed, not only the lines
+  UpdateMemoryMap();
+}
+
+// Read access to the memory mapped chips in $D000-$DDFF
+uint8_t __not_in_flash_func (RpPetra::ReadIO)(uint16_t addr, uint64_t totalCycles)
+{
+  uint8_t ret=0xff;
+
+  // VICII 6569
+  if (addr<0xd400)
+  {
+    ret=m_pVICII->ReadRegister((addr-0xd000) % 64);
+  }
+  // SID6581/6582/8580
+  else if (addr<0xd800) 
+  {
+#ifndef _NO_SID      
+    ret=(uint8_t)sid_read((uint32_t)((addr-0xd400) % 0x20), (cycle_t)totalCycles);
+#endif
+  }
+  else if (addr<0xdd00) // CIA-1
+  {
+    // CIA addresses are mirrored every 16 byte until dcff.          
+    ret=m_pCIA1->ReadRegister((addr-0xdc00) % 16);
+  }
+  else // CIA-2
+  {
+    ret=m_pCIA2->ReadRegister((addr-0xdd00) % 16);
+  }
+  return ret;
+}
+
+// Write access to the memory mapped chips in $D000-$DDFF
+void __not_in_flash_func (RpPetra::WriteIO)(uint16_t addr, uint8_t byte)
+{
+  // VICII 6569
+  if (addr<0xd400)
+  {
+    m_pVICII->WriteRegister(((addr-0xd000) % 64),byte);
+  }
+  // SID6581/6582/8580
+  else if (addr<0xd800) 
+  {
+#ifndef _NO_SID      
+    //static uint16_t sidActivity=0;
+    //if (sidActivity++>0 && sidActivity%100==0)  puts("§");
+    sid_write((uint32_t)((addr-0xd400) % 0x20),byte);
+#endif
+  }
+  else if (addr<0xdd00) // CIA-1
+  {
+    m_pCIA1->WriteRegister((addr-0xdc00) % 16, byte);
+  }
+  else // CIA-2
+  {
+    m_pCIA2->WriteRegister((addr-0xdd00) % 16, byte);
+  }
+}
+
 // Called in case of an NMI (F7) for module starts
 bool RpPetra::HandleModuleStart(uint16_t addr, bool isRead)
 {
@@ -628,6 +557,7 @@ bool RpPetra::HandleModuleStart(uint16_t addr, bool isRead)
       }
 #endif
       nmiStage++;
+      m_pVICII->InvalidateLines();
 
 #ifdef _FLASHDANCE
       uint8_t low=0x3c;
@@ -638,12 +568,12 @@ bool RpPetra::HandleModuleStart(uint16_t addr, bool isRead)
 #endif
       if (addr==0xfffa)
       {
-        WriteDataBus(low);    
+        m_pBus->WriteDataBus(low);    
         ret=true;
       }
       else
       {
-        WriteDataBus(high);    
+        m_pBus->WriteDataBus(high);    
         ret=true;
       }
     }
@@ -651,31 +581,3 @@ bool RpPetra::HandleModuleStart(uint16_t addr, bool isRead)
 #endif          
  return ret;
 }
-
-void __not_in_flash_func (RpPetra::ReadCPUSignals)(SYSTEMSTATE *pSystemState)
-{
-   // read A0-7
-  Enable_U5_only();
-  DELAY_FACTOR_TRANSCEIVER()
-  pSystemState->cpuState.a0a15 = (gpio_get_all() & pioMaskData_U5_U6_U7_RW);
-  pSystemState->cpuState.readNotWrite=pSystemState->cpuState.a0a15 & 0x800;
-  // read A8-15
-  Enable_U6_only();
-  DELAY_FACTOR_TRANSCEIVER();
-  pSystemState->cpuState.a0a15 &= 0xf7ff;
-  pSystemState->cpuState.a0a15 |= (gpio_get_all() & pioMaskData_U5_U6_U7) << 8;
-  // In case 65C02 indicates a write, read databus as well.
-  if (!pSystemState->cpuState.readNotWrite)
-  {
-      Enable_U7_only();
-      DELAY_FACTOR_TRANSCEIVER();
-      pSystemState->cpuState.d0d7=(gpio_get_all() & pioMaskData_U5_U6_U7);    
-  } 
-}
-
-void __not_in_flash_func (RpPetra::WriteDataBus)(uint8_t byte)
-{
-  gpio_set_dir_out_masked(pioMaskData_U5_U6_U7); // set the datalines to output (seen from RP2040 side)
-  gpio_put_masked(pioMaskData_U5_U6_U7,(uint32_t)byte);
-  Enable_U7_only();
-}
@@ -7,35 +7,7 @@
 #ifndef _PETRA_HXX
 #define _PETRA_HXX
 
-typedef struct 
-{
-  bool  isRisingEdge;
-  uint16_t a0a15;
-  uint8_t d0d7;
-  bool readNotWrite;
-  bool isA0A15SetToOutput;
-} CPUSTATE;
-
-typedef struct 
-{
-  CPUSTATE cpuState;
-} SYSTEMSTATE;
-
-/** Mask for pins 0-11, 21 and 28 
- *  A0-A15 multiplexed by 3x 3-state octal bus transceiver 74LVC245APW (pins 0-7)
- *  Multiplexing pins 8,9,10 for output enable signal(OE) for U5, U6 and U7 (high= Z-state, low=enable)
- *  Pin 11 is used for data direction of U7 when OE=low. HIGH=Read from bus, LOW= Write to bus
- *  PIN 25,26,27 are for IRQ, RESET, NMI
- */
-constexpr uint32_t pioMask_CPU = 0b00001110001000000000111111111111; 
-constexpr uint32_t pioMaskData_U5_U6_U7 = 0b011111111; 
-constexpr uint32_t pioMaskData_U5_U6_U7_RW = 0b100011111111; 
-constexpr uint32_t pioMaskOE_U5_U6_U7 =  0b0000000000000000000011100000000; // Modify PIO PINs 8,9 and 10 (74LVC245APW U5, U6 and U7) only
-
-constexpr uint32_t enableU5Only =  0b0000000000000000000011000000000; // set OE (active low) to low on U5 (PIO 8, A0-A7), others to high 
-constexpr uint32_t enableU6Only =  0b0000000000000000000010100000000; // set OE (active low) to low on U6 (PIO 9, A8-A15), others to high  
-constexpr uint32_t enableU7Only =  0b0000000000000000000001100000000; // set OE (active low) to low on U7 (PIO 10, D0-D7), others to high 
-constexpr uint32_t disableU5U6U7 = 0b0000000000000000000011100000000; // set OE (active low) to high for Z-state of U5, U6 and U7
+#define AUTOLOAD_CYCLE 2300000 // KERNAL is done with the RAM test, BASIC is ready
 
 class RpPetra {
   
@@ -44,45 +16,80 @@ class RpPetra {
     VIC6569 *m_pVICII;  
     uint8_t *m_pRAM;
     CIA6526 *m_pCIA1;
-    CIA6526 *m_pCIA2;
+    CIA2 *m_pCIA2;
     Keyboard *m_pKeyboard;
     Joysticks *m_pJoystickA;
     Joysticks *m_pJoystickB; // Not yet.
     uint8_t *m_pColorRam;
+    // Counts the raster lines. The line each page was last written on by the CPU, color RAM
+    // at $D8-$DB, for the VIC to skip rendering unchanged lines. 64 bit, 32 would wrap after 76 hours
+    uint64_t m_writeStamp;
+    uint64_t m_pageWritten[256];
+    Scheduler *m_pScheduler;
+    Governor *m_pGovernor;
+    CpuBus *m_pBus;
+#ifdef _BUS_TRACE
+    BusTrace *m_pBusTrace;
+#endif
   private:
     RP65C02 *m_pCPU;
+#ifndef _HOST
     VideoOut *m_pVideoOut;
-    uint8_t m_cpuAddr;
-    bool m_isBasicRomVisible;
-    bool m_isKernalRomVisible;
-    bool m_isCharRomVisible;
-    bool m_isIOVisible;
+#endif
+    uint64_t m_currentCycle;
+    // VIC DMA (BA low) of the current raster line, bit n: the CPU gets no PHI2 in cycle n of the line
+    uint64_t m_lineStartCycle;
+    uint64_t m_stallMask[VIC_STALL_WORDS];
+    bool m_stalling; // any bit set in m_stallMask
+    uint8_t m_cyclesPerLine;
+    uint8_t m_plaConfig;
+    uint8_t m_plaInput; // PLA table index (cartridge lines, CPU port) of the page tables, 0xff: rebuild
+    // Cartridge port
+    const uint8_t *m_pRomL;
+    const uint8_t *m_pRomH;
+    bool m_game;
+    bool m_exrom;
+    // Memory map, one entry per 256 byte page. nullptr: memory mapped IO handled by ReadIO/WriteIO
+    const uint8_t *m_readPage[256];
+    uint8_t *m_writePage[256];
+    uint8_t m_openBusPage[256];   // not connected in ultimax mode, reads $FF
+    uint8_t m_unmappedPage[256];  // not connected in ultimax mode, writes go nowhere
 
-    inline void Enable_U5_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU5Only); };  
-    inline void Enable_U6_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU6Only); };  
-    inline void Enable_U7_only() { gpio_put_masked(pioMaskOE_U5_U6_U7, enableU7Only); };  
-    inline void DisableBus()     { gpio_put_masked(pioMaskOE_U5_U6_U7, disableU5U6U7);}
-    void ClockCPU(int counter);
-    inline void PHI2(bool isRisingEdge) { gpio_put(CLK,isRisingEdge);}
-    inline void WriteDataBus(uint8_t byte);
-    inline void ReadCPUSignals(SYSTEMSTATE *pSystemState);
-    inline bool IsBasicRomVisible() { return m_isBasicRomVisible;};
-    inline bool IsKernalRomVisible() { return m_isKernalRomVisible;};
-    inline bool IsCharRomVisible() { return m_isCharRomVisible;};
-    inline bool IsIOVisible() { return m_isIOVisible;};
+    inline bool IsBasicRomVisible() { return m_plaConfig & plaBasic;};
+    inline bool IsKernalRomVisible() { return m_plaConfig & plaKernal;};
+    inline bool IsCharRomVisible() { return m_plaConfig & plaCharRom;};
+    inline bool IsIOVisible() { return m_plaConfig & plaIO;};
     bool HandleModuleStart(uint16_t addr, bool isRead);
-    void CalcPLA(uint8_t cpuPort);
+    uint8_t ReadIO(uint16_t addr, uint64_t totalCycles);
+    void WriteIO(uint16_t addr, uint8_t byte);
+    static void Autoload(void *pContext, uint64_t cycle);
     
   public:
     bool m_screenUpdated;
 
-    void Clk(SYSTEMSTATE *pSystemState, uint64_t totalCycles);
+    bool Clk(SYSTEMSTATE *pSystemState, uint64_t totalCycles);
     RpPetra(Logging *pLogging, RP65C02 *pCpu);
     void SignalIRQ(bool enable);
     void SignalNMI(bool enable);
+    void SetCartridge(const uint8_t *pRomL, const uint8_t *pRomH, bool game, bool exrom);
     virtual ~RpPetra();
     void Reset();
+    void SetVicModel(VicModel model);
     void ResetCPU();        
+    inline uint64_t GetCycle() { return m_currentCycle;};
+    void UpdateMemoryMap();
+    // Page tables and PLA table index, for the decoder replay of computer_host -a
+    inline const uint8_t * const *GetReadPages() { return m_readPage;};
+    inline uint8_t * const *GetWritePages() { return m_writePage;};
+    inline uint8_t GetPlaInput() { return m_plaInput;};
+    inline void SetStall(uint64_t lineStartCycle, const uint64_t *pStallMask, uint8_t cyclesPerLine)
+    {
+      m_lineStartCycle=lineStartCycle;
+      m_stallMask[0]=pStallMask[0];
+      m_stallMask[1]=pStallMask[1];
+      m_stalling=(pStallMask[0] | pStallMask[1])!=0;
+      m_cyclesPerLine=cyclesPerLine;
+    };
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+
+#include "stdinclude.hxx"
+
+constexpr uint16_t colorIndex[16]={0x0000,0xffff,0x8187,0x7679,0x89f2,0x55e9,0x2973,0xef8e,0x9a85,0x51c0,0xC36E,0x4228,0x8c51,0x8ff1,0x8c5f,0xce59};
+
+/**
+ * For every frame buffer byte its two pixels as RGB565, the high nibble (left pixel) in the
+ * lower half word, so a byte is converted with one load and one 32-bit store.
+ */
+struct TwinPixelPalette {
+  uint32_t pixels[256];
+
+  constexpr TwinPixelPalette() : pixels()
+  {
+    for (int byte=0;byte<256;byte++)
+    {
+      pixels[byte]=colorIndex[byte >> 4] | (uint32_t)colorIndex[byte & 15] << 16;
+    }
+  }
+};
+
+static_assert(__BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__, "twin pixels are stored as little endian words");
+static TwinPixelPalette __not_in_flash("video") twinPixels;
+
+/**
+ * For every frame buffer byte the colour indices of its four DVI pixels (both pixels doubled),
+ * as stored by ExpandScanLine() for tmds_encode_palette_data().
+ */
+struct QuadIndexTable {
+  uint32_t indices[256];
+
+  constexpr QuadIndexTable() : indices()
+  {
+    for (int byte=0;byte<256;byte++)
+    {
+      uint32_t left=byte >> 4;
+      uint32_t right=byte & 15;
+      indices[byte]=left | left << 8 | right << 16 | right << 24;
+    }
+  }
+};
+
+static QuadIndexTable __not_in_flash("video") quadIndices;
+
+// The SCANLINE_PIXELS shown of a frame buffer line, pScanLine is 32-bit aligned
+void __not_in_flash_func (ConvertScanLine)(const uint8_t *pFrameLine, uint32_t *pScanLine)
+{
+  const uint8_t *pBytes=pFrameLine+SCANLINE_OFFSET;
+  const uint32_t *pPixels=twinPixels.pixels;
+  int i=0;
+  for (;i<SCANLINE_PIXELS/2-7;i+=8)
+  {
+    pScanLine[i]=pPixels[pBytes[i]];
+    pScanLine[i+1]=pPixels[pBytes[i+1]];
+    pScanLine[i+2]=pPixels[pBytes[i+2]];
+    pScanLine[i+3]=pPixels[pBytes[i+3]];
+    pScanLine[i+4]=pPixels[pBytes[i+4]];
+    pScanLine[i+5]=pPixels[pBytes[i+5]];
+    pScanLine[i+6]=pPixels[pBytes[i+6]];
+    pScanLine[i+7]=pPixels[pBytes[i+7]];
+  }
+  // 340 pixels, two bytes left
+  for (;i<SCANLINE_PIXELS/2;i++)
+  {
+    pScanLine[i]=pPixels[pBytes[i]];
+  }
+}
+
+// The 2*SCANLINE_PIXELS colour indices of the shown part of a frame buffer line, pIndices is 32-bit aligned
+void __not_in_flash_func (ExpandScanLine)(const uint8_t *pFrameLine, uint32_t *pIndices)
+{
+  const uint8_t *pBytes=pFrameLine+SCANLINE_OFFSET;
+  const uint32_t *pQuads=quadIndices.indices;
+  int i=0;
+  for (;i<SCANLINE_PIXELS/2-7;i+=8)
+  {
+    pIndices[i]=pQuads[pBytes[i]];
+    pIndices[i+1]=pQuads[pBytes[i+1]];
+    pIndices[i+2]=pQuads[pBytes[i+2]];
+    pIndices[i+3]=pQuads[pBytes[i+3]];
+    pIndices[i+4]=pQuads[pBytes[i+4]];
+    pIndices[i+5]=pQuads[pBytes[i+5]];
+    pIndices[i+6]=pQuads[pBytes[i+6]];
+    pIndices[i+7]=pQuads[pBytes[i+7]];
+  }
+  for (;i<SCANLINE_PIXELS/2;i++)
+  {
+    pIndices[i]=pQuads[pBytes[i]];
+  }
+}
+
+// A C64 colour as 0xRRGGBB, the low bits of each channel repeat its high bits
+uint32_t ColorRGB888(uint8_t color)
+{
+  uint32_t rgb565=colorIndex[color & 15];
+  uint32_t red=rgb565 >> 11;
+  uint32_t green=(rgb565 >> 5) & 0x3f;
+  uint32_t blue=rgb565 & 0x1f;
+  return (red << 3 | red >> 2) << 16 | (green << 2 | green >> 4) << 8 | (blue << 3 | blue >> 2);
+}
+
+// SCANLINE_PIXELS/2 words of a scanline in one value
+static inline void FillScanLine(uint32_t *pScanLine, uint32_t value)
+{
+  int i=0;
+  for (;i<SCANLINE_PIXELS/2-7;i+=8)
+  {
+    pScanLine[i]=value;
+    pScanLine[i+1]=value;
+    pScanLine[i+2]=value;
+    pScanLine[i+3]=value;
+    pScanLine[i+4]=value;
+    pScanLine[i+5]=value;
+    pScanLine[i+6]=value;
+    pScanLine[i+7]=value;
+  }
+  for (;i<SCANLINE_PIXELS/2;i++)
+  {
+    pScanLine[i]=value;
+  }
+}
+
+/**
+ * The scanline of a frame buffer line, as RGB565 or as colour indices (_TMDS_PALETTE). A line in
+ * one colour (fill, see VIC6569::GetLineFill()) is written without reading the frame buffer, and
+ * not at all if pScanLine already holds it. Returns false if pScanLine was kept.
+ */
+bool __not_in_flash_func (BuildScanLine)(ScanLineCache *pCache, const uint8_t *pFrameLine, uint8_t fill, uint32_t *pScanLine)
+{
+  if (fill!=VIC_LINE_FILL_MIXED && fill==pCache->fill && pScanLine==pCache->pScanLine)
+  {
+    return false;
+  }
+  pCache->pScanLine=pScanLine;
+  pCache->fill=fill;
+#ifdef _TMDS_PALETTE
+  if (fill!=VIC_LINE_FILL_MIXED)
+  {
+    FillScanLine(pScanLine,quadIndices.indices[fill*0x11]);
+  }
+  else
+  {
+    ExpandScanLine(pFrameLine,pScanLine);
+  }
+#else
+  if (fill!=VIC_LINE_FILL_MIXED)
+  {
+    FillScanLine(pScanLine,twinPixels.pixels[fill*0x11]);
+  }
+  else
+  {
+    ConvertScanLine(pFrameLine,pScanLine);
+  }
+#endif
+  return true;
+}
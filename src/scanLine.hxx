@@ -0,0 +1,32 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * DVI scanlines from frame buffer lines, used by VideoOut and by the host benchmark.
+*/
+
+#ifndef _SCAN_LINE_HXX
+#define _SCAN_LINE_HXX
+
+#define SCANLINE_PIXELS 340
+#define SCANLINE_OFFSET ((VIC_FRAME_WIDTH-SCANLINE_PIXELS)/4) // frame buffer bytes left of the shown part
+
+// C64 color schema as 565
+extern const uint16_t colorIndex[16];
+
+void ConvertScanLine(const uint8_t *pFrameLine, uint32_t *pScanLine);
+
+// _TMDS_PALETTE: scanlines of colour indices (one byte per DVI pixel) for libdvi's palette encoder
+#define SCANLINE_INDEX_BITS 4
+
+void ExpandScanLine(const uint8_t *pFrameLine, uint32_t *pIndices);
+uint32_t ColorRGB888(uint8_t color);
+
+// What a scanline buffer was last written with, a line in one colour is only written when the colour changes
+typedef struct {
+  const uint32_t *pScanLine;
+  uint8_t fill; // colour of the whole line, VIC_LINE_FILL_MIXED: converted from a frame buffer line
+} ScanLineCache;
+
+bool BuildScanLine(ScanLineCache *pCache, const uint8_t *pFrameLine, uint8_t fill, uint32_t *pScanLine);
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+*/
+#include "stdinclude.hxx"
+
+Scheduler::Scheduler()
+{
+  for (int i=0;i<NUM_OF_EVENTS;i++)
+  {
+    m_events[i].pHandler=nullptr;
+    m_events[i].pContext=nullptr;
+  }
+  Reset();
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+// Cancels all events, handlers stay registered.
+void Scheduler::Reset()
+{
+  memset(m_heapPos,0xff,sizeof(m_heapPos));
+  m_heapSize=0;
+  UpdateNextEventCycle();
+}
+
+void Scheduler::Register(EventId id, EventHandler pHandler, void *pContext)
+{
+  m_events[id].pHandler=pHandler;
+  m_events[id].pContext=pContext;
+}
+
+void __not_in_flash_func (Scheduler::SiftUp)(uint8_t pos)
+{
+  uint8_t id=m_heap[pos];
+  while (pos>0)
+  {
+    uint8_t parent=(pos-1)/2;
+    if (m_events[m_heap[parent]].cycle<=m_events[id].cycle)
+    {
+      break;
+    }
+    m_heap[pos]=m_heap[parent];
+    m_heapPos[m_heap[pos]]=pos;
+    pos=parent;
+  }
+  m_heap[pos]=id;
+  m_heapPos[id]=pos;
+}
+
+void __not_in_flash_func (Scheduler::SiftDown)(uint8_t pos)
+{
+  uint8_t id=m_heap[pos];
+  while (true)
+  {
+    uint8_t child=pos*2+1;
+    if (child>=m_heapSize)
+    {
+      break;
+    }
+    if (child+1<m_heapSize && m_events[m_heap[child+1]].cycle<m_events[m_heap[child]].cycle)
+    {
+      child++;
+    }
+    if (m_events[id].cycle<=m_events[m_heap[child]].cycle)
+    {
+      break;
+    }
+    m_heap[pos]=m_heap[child];
+    m_heapPos[m_heap[pos]]=pos;
+    pos=child;
+  }
+  m_heap[pos]=id;
+  m_heapPos[id]=pos;
+}
+
+void __not_in_flash_func (Scheduler::Remove)(uint8_t pos)
+{
+  uint8_t id=m_heap[pos];
+  m_heapPos[id]=0xff;
+  if (pos!=--m_heapSize)
+  {
+    // Move the last entry into the gap, it may have to go either way
+    uint8_t moved=m_heap[m_heapSize];
+    m_heap[pos]=moved;
+    m_heapPos[moved]=pos;
+    SiftDown(pos);
+    SiftUp(m_heapPos[moved]);
+  }
+}
+
+void __not_in_flash_func (Scheduler::Schedule)(EventId id, uint64_t cycle, uint32_t period)
+{
+  m_events[id].cycle=cycle;
+  m_events[id].period=period;
+  if (m_heapPos[id]==0xff)
+  {
+    m_heap[m_heapSize]=id;
+    m_heapPos[id]=m_heapSize++;
+    SiftUp(m_heapPos[id]);
+  }
+  else
+  {
+    SiftUp(m_heapPos[id]);
+    SiftDown(m_heapPos[id]);
+  }
+  UpdateNextEventCycle();
+}
+
+void __not_in_flash_func (Scheduler::Cancel)(EventId id)
+{
+  if (m_heapPos[id]!=0xff)
+  {
+    Remove(m_heapPos[id]);
+    UpdateNextEventCycle();
+  }
+}
+
+// The heap is updated before a handler runs, so handlers may schedule or cancel any event.
+void __not_in_flash_func (Scheduler::Dispatch)(uint64_t now)
+{
+  while (m_heapSize>0 && m_events[m_heap[0]].cycle<=now)
+  {
+    uint8_t id=m_heap[0];
+    Event *pEvent=&m_events[id];
+    uint64_t cycle=pEvent->cycle;
+    
+    if (pEvent->period)
+    {
+      pEvent->cycle+=pEvent->period;
+      SiftDown(0);
+    }
+    else
+    {
+      Remove(0);
+    }
+    UpdateNextEventCycle();
+    pEvent->pHandler(pEvent->pContext,cycle);
+  }
+}
@@ -0,0 +1,67 @@
+/**
+ * Written by Bernd Krekeler, Herne, Germany
+ * 
+ * Cycle-stamped event scheduler. Everything that used to be checked on every bus cycle
+ * (line boundaries, timer underflows, USB polling, game autoload) registers an event
+ * here, so the main loop only has a single "next event" compare per cycle.
+*/
+
+#ifndef _SCHEDULER_HXX
+#define _SCHEDULER_HXX
+
+typedef enum {
+  EventUsbPoll=0,
+  EventAutoload,
+  EventVicLine,
+  EventVicRaster,
+  EventCia1TimerA,
+  EventCia1TimerB,
+  EventCia2TimerA,
+  EventCia2TimerB,
+  EventBusTrace,
+  EventGovernor,
+  NUM_OF_EVENTS
+} EventId;
+
+#define EVENT_NEVER 0xffffffffffffffffULL
+
+// Called with the cycle the event was scheduled for
+typedef void (*EventHandler)(void *pContext, uint64_t cycle);
+
+class Scheduler {
+
+  private:
+    typedef struct {
+      uint64_t cycle;
+      uint32_t period; // 0= one-shot
+      EventHandler pHandler;
+      void *pContext;
+    } Event;
+
+    Event m_events[NUM_OF_EVENTS];
+    // Min-heap of scheduled event ids, keyed on cycle
+    uint8_t m_heap[NUM_OF_EVENTS];
+    uint8_t m_heapPos[NUM_OF_EVENTS];
+    uint8_t m_heapSize;
+    uint64_t m_nextEventCycle;
+
+    void SiftUp(uint8_t pos);
+    void SiftDown(uint8_t pos);
+    void Remove(uint8_t pos);
+    inline void UpdateNextEventCycle() { m_nextEventCycle=m_heapSize ? m_events[m_heap[0]].cycle : EVENT_NEVER; };
+
+  public:
+    Scheduler();
+    virtual ~Scheduler();
+    void Reset();
+    void Register(EventId id, EventHandler pHandler, void *pContext);
+    // (Re)schedules an event, a period>0 repeats it every period cycles.
+    void Schedule(EventId id, uint64_t cycle, uint32_t period=0);
+    void Cancel(EventId id);
+    inline bool IsScheduled(EventId id) { return m_heapPos[id]!=0xff;};
+    inline uint64_t GetNextEventCycle() { return m_nextEventCycle;};
+    // Runs all events due at or before cycle now.
+    void Dispatch(uint64_t now);
+};
+
+#endif
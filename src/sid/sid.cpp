@@ -18,7 +18,11 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include <time.h>
+#ifdef _HOST
+#include "../hostPlatform.hxx"
+#else
 #include <pico/stdlib.h>
+#endif
 #include <cstdint>
 
 #include "sys.h"
@@ -89,6 +93,7 @@ static fp24p8_t sid_cycles_frac;    // With fractional part
 
 // Phi2 clock frequency
 static cycle_t cycles_per_second;
+static const char *vic_type = "6569";   // VIC type the clock is taken from
 const fp24p8_t PAL_CLOCK = ftofp24p8(985248.444);
 const fp24p8_t NTSC_OLD_CLOCK = ftofp24p8(1000000.0);
 const fp24p8_t NTSC_CLOCK = ftofp24p8(1022727.143);
@@ -551,7 +556,7 @@ void SIDInit()
     // PrefsSetCallbackBool("stereo", prefs_stereo_changed);
     // PrefsSetCallbackBool("filters", prefs_filters_changed);
     // PrefsSetCallbackBool("dualsid", prefs_dualsid_changed);
-    set_cycles_per_second("6569");
+    set_cycles_per_second(vic_type);
     speed_adjust = 100;//PrefsFindInt32("speed");
     // PrefsSetCallbackString("victype", prefs_victype_changed);
     // PrefsSetCallbackInt32("speed", prefs_speed_changed);
@@ -722,6 +727,19 @@ void SIDClockFreqChanged()
 }
 
 
+/*
+ *  Set VIC type ("6569", "6567R8", "6567R56A"), it selects the system clock
+ */
+
+void SIDSetVicType(const char *victype)
+{
+    vic_type = victype;
+    set_cycles_per_second(vic_type);
+    if (sid1)
+        SIDClockFreqChanged();
+}
+
+
 /*
  *  Set replay frequency
  */
@@ -43,6 +43,9 @@ extern void SIDCalcBuffer(uint8_t *buf, int count);
 // Execute 6510 replay routine once
 extern void SIDExecute();
 
+// Set VIC type, selects the system clock
+extern void SIDSetVicType(const char *victype);
+
 // Set replay frequency and speed adjustment
 extern void SIDSetReplayFreq(int freq);
 extern void SIDAdjustSpeed(int percent);
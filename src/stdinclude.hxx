@@ -4,6 +4,9 @@
 #include <stdio.h>
 #include <vector>
 #include <memory.h>
+#ifdef _HOST
+#include "hostPlatform.hxx"
+#else
 #include <hardware/adc.h>
 #include <hardware/gpio.h>
 #include <hardware/regs/resets.h>
@@ -12,30 +15,52 @@
 #include <hardware/structs/bus_ctrl.h>
 #include <hardware/pwm.h>
 #include <hardware/clocks.h>
+#include <hardware/pio.h>
 #include <pico/stdlib.h>
 #include <pico/multicore.h>
 #include <pico/time.h>
 #include <pico/bootrom.h>
 #include <dvi.h>
 #include <dvi_serialiser.h>
+#include <tmds_encode.h>
 #include <bsp/board_api.h>
 #include <tusb.h>
+#endif
 #include "terminalBase.hxx"
 #include "ansiTerminal.hxx"
 #include "logging.hxx"
+#include "hostCpu.hxx"
+#include "opcodes6510.hxx"
 #include "rp65c02.hxx"
+#include "scheduler.hxx"
+#include "governor.hxx"
+#include "cpuBus.hxx"
 #include "cia6526.hxx"
 #include "cia1.hxx"
 #include "cia2.hxx"
 #include "vic6569.hxx"
 #include "sid/sid.h"
+#include "scanLine.hxx"
+#ifndef _HOST
 #include "videoOut.hxx"
+#endif
 #include "keyboard.hxx"
 #include "joysticks.hxx"
 #include "competitionPro.hxx"
 #include "snes.hxx"
+#include "busSequencerModel.hxx"
+#ifdef _HOST
+#include "hostBus.hxx"
+#else
+#include "busSequencer.hxx"
+#include "gpioBus.hxx"
+#endif
+#include "pla.hxx"
+#include "busTrace.hxx"
 #include "rpPetra.hxx"
+#ifndef _HOST
 #include "computer.hxx"
+#endif
 
 extern uint8_t chargen_rom[];
 extern uint8_t basic_rom[];
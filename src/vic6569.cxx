@@ -5,741 +5,1445 @@
 
 #include "stdinclude.hxx"
 
+/**
+ * For every pattern of 8 hires pixels the 32-bit mask of the four frame buffer bytes,
+ * a nibble is 0xf where the pixel is set. Byte 0 holds bits 7 (high nibble) and 6.
+ */
+struct VicHiresMask {
+  uint32_t mask[256];
+
+  constexpr VicHiresMask() : mask()
+  {
+    for (int bits=0;bits<256;bits++)
+    {
+      for (int pixel=0;pixel<8;pixel++)
+      {
+        if (bits & (0x80>>pixel))
+        {
+          mask[bits]|=0xfu << ((pixel/2)*8+((pixel & 1) ? 0 : 4));
+        }
+      }
+    }
+  }
+};
+
+// Indexed by VicModel
+static const VicTiming vicTimings[]={
+  {63,312,PAL_CLOCK_HZ,"6569"},
+  {65,263,NTSC_CLOCK_HZ,"6567R8"},
+  {64,262,NTSC_CLOCK_HZ,"6567R56A"}
+};
+
+static_assert(__BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__, "hires masks are stored as little endian words");
+
+static VicHiresMask __not_in_flash("vic") hiresMask;
+
+// 8 hires pixels into four frame buffer bytes, pDest is 32-bit aligned
+static inline void ExpandHires(uint8_t *pDest, uint8_t bits, uint8_t foregroundColor, uint8_t backgroundColor)
+{
+  uint32_t mask=hiresMask.mask[bits];
+  *(uint32_t *)pDest=((foregroundColor*0x11111111u) & mask) | ((backgroundColor*0x11111111u) & ~mask);
+}
+
+// 4 multicolor pixels (2-bit indices into pColors, both nibbles of each set) into four frame buffer bytes
+static inline void ExpandMulticolor(uint8_t *pDest, uint8_t bits, const uint8_t *pColors)
+{
+  *(uint32_t *)pDest=pColors[bits >> 6] | (pColors[(bits >> 4) & 3] << 8) | (pColors[(bits >> 2) & 3] << 16) | ((uint32_t)pColors[bits & 3] << 24);
+}
+
+// Multicolor pixels %10 and %11 are foreground, %00 and %01 count as background
+static inline uint8_t MulticolorForeground(uint8_t bits)
+{
+  return (bits & 0xaa) | ((bits & 0xaa) >> 1);
+}
+
+// Pixels from to to-1 of a frame buffer line in one color
+static inline void FillPixels(uint8_t *pFrameLine, int from, int to, uint8_t color)
+{
+  if (from & 1)
+  {
+    pFrameLine[from >> 1]=(pFrameLine[from >> 1] & 0xf0) | color;
+    from++;
+  }
+  if ((to & 1) && to>from)
+  {
+    pFrameLine[to >> 1]=(pFrameLine[to >> 1] & 0x0f) | (color << 4);
+    to--;
+  }
+  if (to>from)
+  {
+    memset(pFrameLine+(from >> 1),color*0x11,(to-from) >> 1);
+  }
+}
+
+// 24 sprite pixels to 48, each one doubled
+static inline uint64_t DoublePixels(uint32_t pixels)
+{
+  uint64_t x=pixels;
+  x=(x | (x << 16)) & 0x0000ffff0000ffffull;
+  x=(x | (x << 8)) & 0x00ff00ff00ff00ffull;
+  x=(x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+  x=(x | (x << 2)) & 0x3333333333333333ull;
+  x=(x | (x << 1)) & 0x5555555555555555ull;
+  return x | (x << 1);
+}
+
+/**
+ * Sprite pixel masks are 64-bit, leftmost pixel in bit 63. A raster line of them is an array of
+ * masks covering the sprite X coordinates 0-575, pixel x in bit 63-(x%64) of word x/64.
+ */
+static inline uint64_t GetSpriteWindow(const uint64_t *pLineMask, int x)
+{
+  int shift=x & 63;
+  uint64_t window=pLineMask[x >> 6];
+  return shift ? (window << shift) | (pLineMask[(x >> 6)+1] >> (64-shift)) : window;
+}
+
+static inline void OrSpriteWindow(uint64_t *pLineMask, int x, uint64_t mask)
+{
+  int shift=x & 63;
+  pLineMask[x >> 6]|=mask >> shift;
+  if (shift)
+  {
+    pLineMask[(x >> 6)+1]|=mask << (64-shift);
+  }
+}
+
+// The 64 foreground pixels from frame buffer column px on, 0 outside the display window
+static inline uint64_t GetForegroundWindow(const uint8_t *pForeground, int px)
+{
+  uint64_t window=0;
+  int cell=px >> 3;
+  int shift=px & 7;
+  for (int i=0;i<8;i++,cell++)
+  {
+    window=(window << 8) | ((cell>=0 && cell<40) ? pForeground[cell] : 0);
+  }
+  if (shift && cell>=0 && cell<40)
+  {
+    window=(window << shift) | (pForeground[cell] >> (8-shift));
+  }
+  else if (shift)
+  {
+    window<<=shift;
+  }
+  return window;
+}
+
 VIC6569::VIC6569(Logging *pLogging, RpPetra *pGlue)
 {
    m_pLog=pLogging;
    m_pGlue=pGlue;
-   // We need a frame buffer of only 160*200 due to 4-bit per Pixel
-   m_pFrameBuffer=(uint8_t *)calloc((160*200),sizeof(uint8_t));
+   // 4-bit per pixel, the display window and the part of the border the DVI output shows
+#ifdef _FRAME_PACING
+   m_pFrameBuffers=(uint8_t *)calloc(VIC_FRAME_SIZE*VIC_FRAME_BUFFERS,sizeof(uint8_t));
+   m_renderedFrame=0;
+   m_latestFrame=1;
+   m_shownFrame=1;
+   m_pFrameBuffer=m_pFrameBuffers;
+   m_frameStarted=false;
+   m_framesCompleted=0;
+   m_framesShown=0;
+   m_framesRepeated=0;
+#else
+   m_pFrameBuffer=(uint8_t *)calloc(VIC_FRAME_SIZE,sizeof(uint8_t));
+#endif
+   m_lineHead=0;
+   m_lineTail=0;
+   m_linesRenderedInline=0;
+   m_lineCollected=0;
+   m_linesRendered=0;
+   m_linesSkipped=0;
+#ifdef _NTSC
+   m_model=Vic6567R8;
+#else
+   m_model=Vic6569;
+#endif
 }
 
 VIC6569::~VIC6569() {};
 
+// Takes effect with the next Reset()
+void VIC6569::SetModel(VicModel model)
+{
+  m_model=model;
+}
+
+const VicTiming *VIC6569::GetTiming()
+{
+  return &vicTimings[m_model];
+}
+
+// Scheduler event handler, context is the VIC
+static void __not_in_flash_func (OnNextLine)(void *pContext, uint64_t cycle)
+{
+  ((VIC6569 *)pContext)->NextLine(cycle);
+}
+
+// Scheduler event handler, context is the VIC
+static void __not_in_flash_func (OnRasterMatch)(void *pContext, uint64_t cycle)
+{
+  ((VIC6569 *)pContext)->RasterMatch(cycle);
+}
+
 void VIC6569::Reset() 
 {
-  m_i64Clks=0;
   memset(m_registerSetWrite,0,sizeof(m_registerSetWrite));
   memset(m_registerSetRead,0,sizeof(m_registerSetRead));
   // set current scan line to 0
   m_currentScanLine=0;
+  m_cyclesPerLine=vicTimings[m_model].cyclesPerLine;
+  m_lines=vicTimings[m_model].lines;
+  // NTSC has no raster lines for the bottom rows of the frame buffer
+#ifdef _FRAME_PACING
+  memset(m_pFrameBuffers,0,VIC_FRAME_SIZE*VIC_FRAME_BUFFERS);
+#else
+  memset(m_pFrameBuffer,0,VIC_FRAME_SIZE);
+#endif
+  memset(m_lineFill,0,sizeof(m_lineFill));
+  m_bank=m_pGlue->m_pCIA2->GetVicBank();
+  BuildBankViews();
+  InvalidateLines();
+#ifdef _RACE_THE_BEAM
+  // Border in colour 0 until core0 has taken the line
+  VicLine border={};
+  border.window=VIC_WINDOW_BORDER;
+  for (int row=0;row<VIC_FRAME_LINES;row++)
+  {
+    border.line=VIC_FRAME_FIRST_LINE+row;
+    memcpy(m_frameLines[row],&border,sizeof(m_frameLines[row]));
+    m_frameLineSeq[row]=0;
+    m_frameLineReported[row]=0;
+  }
+  m_raceRendered=0;
+  m_raceShown=0;
+  m_raceCollisionHead=0;
+  m_lineCollected=0;
+#endif
+  m_verticalBorder=true;
+  m_mainBorder=true;
+  m_lineStartCycle=m_pGlue->GetCycle();
+  memset(m_spritesOnLine,0,sizeof(m_spritesOnLine));
+  memset(m_spriteHeight,0,sizeof(m_spriteHeight));
+  for (int sprite=0;sprite<8;sprite++)
+  {
+    m_spriteTop[sprite]=0;
+    UpdateSpriteLines(sprite);
+  }
+  // Every 63 (6569), 64 (6567R56A) or 65 (6567R8) clocks the VIC starts a new line
+  Scheduler *pScheduler=m_pGlue->m_pScheduler;
+  pScheduler->Register(EventVicLine,OnNextLine,this);
+  pScheduler->Schedule(EventVicLine,m_pGlue->GetCycle()+m_cyclesPerLine,m_cyclesPerLine);
+  pScheduler->Register(EventVicRaster,OnRasterMatch,this);
+  m_rasterCompare=0xffff;
+  m_rasterMatchCycle=0;
+  UpdateRasterCompare();
+  TakeSnapshot(&m_line);
 }
 
-void __not_in_flash_func (VIC6569::UpdateFrameBuffer)()
+void __not_in_flash_func (VIC6569::Render)(VicLine *pLine)
 {
-  uint8_t value=m_registerSetRead[0x11];
+  uint8_t value=pLine->d011;
+  bool visible=pLine->line>=VIC_FRAME_FIRST_LINE && pLine->line<VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES;
+  // Only border if the main border flip-flop is not reset in this line
+  bool border=(pLine->window & (VIC_WINDOW_BORDER | VIC_WINDOW_OPEN_LEFT))==VIC_WINDOW_BORDER;
   
-  if (value & 0x10) // At least, display is on
+  if (visible && !border)
+  {
+    // YSCROLL, the first graphics line is $30+YSCROLL. Idle in the open upper and lower border.
+    int graphicsLine=pLine->line-0x30-(value & 0x07);
+    bool idle=!(value & 0x10) || (pLine->window & VIC_WINDOW_BORDER) || graphicsLine<0 || graphicsLine>=200;
+    pLine->graphicsLine=graphicsLine;
+    uint8_t *pFrameLine=GetFrameLine(pLine->line);
+    uint8_t sideColor=((value & 0b00100000) ? 0 : pLine->background[0])*0x11;
+    memset(pFrameLine,sideColor,VIC_FRAME_BORDER/2);
+    memset(pFrameLine+(VIC_FRAME_BORDER+320)/2,sideColor,VIC_FRAME_BORDER/2);
+    if (pLine->changes)
+    {
+      ReplayChanges(pLine,idle);
+    }
+    else
+    {
+      RenderCells(pLine,idle,0,40);
+    }
+    if (!idle && (pLine->d016 & 0x07))
+    {
+      ScrollLine(pLine);
+    }
+  }
+  else
+  {
+    memset(pLine->foreground,0,sizeof(pLine->foreground));
+  }
+  pLine->collisions=0;
+  if (pLine->sprites)
+  {
+    DrawSprites(pLine,visible);
+  }
+  if (visible)
+  {
+    DrawWindow(pLine);
+  }
+}  
+
+// The character cells first to last-1 in the mode the line is in at that point
+void __not_in_flash_func (VIC6569::RenderCells)(VicLine *pLine, bool idle, int first, int last)
+{
+  uint8_t value=pLine->d011;
+  if (idle)
   {
-    if (m_currentScanLine>END_SCANLINE_UPPER_BORDER_PAL && m_currentScanLine<START_SCANLINE_LOWER_BORDER_PAL)
+    RenderIdleLine(pLine,first,last);
+  }
+  else if ((value & 0b00100000)==0) // Textmode?
+  {
+    // Extended color mode?
+    if (value & 0b01000000)
     {
-      if ((value & 0b00100000)==0) // Textmode?
+      HandleExtendedColorMode(pLine,first,last); // extended color mode (ECM)?
+    }
+    else {
+      HandleTextMode(pLine,pLine->d016 & 0b00010000,first,last); // multicolor text mode?
+    }
+  }
+  else 
+  {
+    HandleHiresModes(pLine,pLine->d016 & 0b00010000,first,last);
+  }
+}
+
+/**
+ * Renders the line in sections, a register written in the line takes effect from the cell shown
+ * in the cycle after the write on. YSCROLL, XSCROLL and the window sizes stay as they were at the
+ * start of the line, sprites see the registers as they are at its end.
+ */
+void __not_in_flash_func (VIC6569::ReplayChanges)(VicLine *pLine, bool idle)
+{
+  uint8_t d011=pLine->d011;
+  uint8_t d016=pLine->d016;
+  uint8_t border=pLine->border;
+  int first=0;
+  for (int change=0;change<pLine->changes;change++)
+  {
+    const VicChange *pChange=&pLine->change[change];
+    int cell=pChange->cycle-VIC_FIRST_CELL_CYCLE;
+    if (cell>first)
+    {
+      cell=cell<40 ? cell : 40;
+      RenderCells(pLine,idle,first,cell);
+      first=cell;
+    }
+    switch (pChange->reg)
+    {
+      case 0x11: // ECM, BMM
+        pLine->d011=(pChange->value & 0b01100000) | (d011 & 0b10011111);
+      break;
+      case 0x16: // MCM
+        pLine->d016=(pChange->value & 0b00010000) | (d016 & 0b11101111);
+      break;
+      case 0x18:
+        pLine->d018=pChange->value;
+      break;
+      case 0x20:
+        pLine->border=pChange->value & 0x0f;
+      break;
+      case VIC_CHANGE_BANK:
+        pLine->bank=pChange->value;
+      break;
+      default: // $D021-$D024
+        pLine->background[pChange->reg-0x21]=pChange->value & 0x0f;
+      break;
+    }
+  }
+  if (first<40)
+  {
+    RenderCells(pLine,idle,first,40);
+  }
+  pLine->d011=d011;
+  pLine->d016=d016;
+  pLine->border=border;
+}
+
+/**
+ * Lines between the upper border and the first graphics line (YSCROLL) or after the last one.
+ * The VIC shows the byte at $3FFF there in black, we assume it is 0.
+ */
+void __not_in_flash_func (VIC6569::RenderIdleLine)(VicLine *pLine, int first, int last)
+{
+  uint8_t color=(pLine->d011 & 0b00100000) ? 0 : pLine->background[0];
+  memset(GetLinePixels(pLine->line)+first*4,color*0x11,(last-first)*4);
+  memset(pLine->foreground+first,0,last-first);
+}
+
+/**
+ * XSCROLL moves the graphics right by 0-7 pixels, background color shows up on the left.
+ * Pixels are nibbles, the first one in the upper nibble, so the line is shifted as big endian
+ * words, 8 pixels at a time.
+ */
+void __not_in_flash_func (VIC6569::ScrollLine)(VicLine *pLine)
+{
+  uint32_t *pWords=(uint32_t *)GetLinePixels(pLine->line);
+  int scroll=pLine->d016 & 0x07;
+  int shift=scroll*4;
+  uint32_t right=__builtin_bswap32(pWords[39]);
+  for (int i=39;i>0;i--)
+  {
+    uint32_t left=__builtin_bswap32(pWords[i-1]);
+    pWords[i]=__builtin_bswap32((right >> shift) | (left << (32-shift)));
+    right=left;
+  }
+  pWords[0]=__builtin_bswap32((right >> shift) | ((pLine->background[0]*0x11111111u) << (32-shift)));
+
+  uint8_t *pForeground=pLine->foreground;
+  for (int i=39;i>0;i--)
+  {
+    pForeground[i]=(pForeground[i] >> scroll) | (pForeground[i-1] << (8-scroll));
+  }
+  pForeground[0]>>=scroll;
+}
+
+/**
+ * The border where the main border flip-flop is set (see UpdateWindow()): left of X 24 (40 columns)
+ * or X 31 (38 columns) and from X 344 or X 335 on, the whole line in the upper and lower border.
+ */
+void __not_in_flash_func (VIC6569::DrawWindow)(VicLine *pLine)
+{
+  uint8_t window=pLine->window;
+  int left=VIC_FRAME_BORDER+((window & VIC_WINDOW_LEFT38) ? 7 : 0);
+  int right=VIC_FRAME_BORDER+((window & VIC_WINDOW_RIGHT38) ? 311 : 320);
+  if (window & VIC_WINDOW_OPEN_LEFT)
+  {
+    left=0;
+  }
+  else if (window & VIC_WINDOW_BORDER)
+  {
+    left=VIC_FRAME_WIDTH;
+  }
+  if (window & VIC_WINDOW_OPEN_RIGHT)
+  {
+    right=VIC_FRAME_WIDTH;
+  }
+  uint8_t fill=VIC_LINE_FILL_MIXED;
+  if (left>=right)
+  {
+    fill=DrawBorder(pLine,0,VIC_FRAME_WIDTH);
+  }
+  else
+  {
+    if (left>0)
+    {
+      DrawBorder(pLine,0,left);
+    }
+    if (right<VIC_FRAME_WIDTH)
+    {
+      DrawBorder(pLine,right,VIC_FRAME_WIDTH);
+    }
+  }
+  m_lineFill[GetFrameRow(GetFrameLine(pLine->line))]=fill;
+}
+
+/**
+ * Frame buffer pixels from to to-1 in the border color, which may change within the line ($D020 writes).
+ * Returns the color if it has not changed within from to to-1, VIC_LINE_FILL_MIXED otherwise.
+ */
+uint8_t __not_in_flash_func (VIC6569::DrawBorder)(VicLine *pLine, int from, int to)
+{
+  uint8_t *pFrameLine=GetFrameLine(pLine->line);
+  uint8_t color=pLine->border;
+  bool mixed=false;
+  for (int change=0;change<pLine->changes;change++)
+  {
+    const VicChange *pChange=&pLine->change[change];
+    if (pChange->reg!=0x20)
+    {
+      continue;
+    }
+    int px=VIC_FRAME_BORDER+(pChange->cycle-VIC_FIRST_CELL_CYCLE)*8;
+    if (px>=to)
+    {
+      break;
+    }
+    if (px>from)
+    {
+      FillPixels(pFrameLine,from,px,color);
+      from=px;
+      mixed=mixed || color!=(pChange->value & 0x0f);
+    }
+    color=pChange->value & 0x0f;
+  }
+  FillPixels(pFrameLine,from,to,color);
+  return mixed ? VIC_LINE_FILL_MIXED : color;
+}
+
+/**
+ * Sprite 0 has the highest priority. A pixel is taken by the first sprite that is not transparent
+ * there, even if that sprite is behind the graphics ($D01B). Collisions are found on the whole
+ * line, sprite-background collisions only where graphics are displayed.
+ */
+void __not_in_flash_func (VIC6569::DrawSprites)(VicLine *pLine, bool visible)
+{
+  uint64_t taken[9]={};
+  uint64_t masks[8];
+  const uint8_t * const *pBank=m_bankView[pLine->bank];
+  uint16_t spritePointers=GetVideoRamAddrOffset(pLine)+0x3f8;
+  uint8_t *pFrameLine=GetFrameLine(pLine->line);
+  uint8_t spriteCollisions=0;
+  uint8_t backgroundCollisions=0;
+
+  for (int sprite=0;sprite<8;sprite++)
+  {
+    uint8_t bit=1 << sprite;
+    if (!(pLine->sprites & bit))
+    {
+      continue;
+    }
+    uint16_t data=FetchByte(pBank,spritePointers+sprite)*64+pLine->spriteRow[sprite]*3;
+    uint32_t pixels=(FetchByte(pBank,data) << 16) | (FetchByte(pBank,data+1) << 8) | FetchByte(pBank,data+2);
+    uint32_t opaque=pixels;
+    if (pLine->d01c & bit)
+    {
+      opaque=(pixels | (pixels >> 1)) & 0x555555;
+      opaque|=opaque << 1;
+    }
+    uint8_t expand=(pLine->d01d & bit) ? 1 : 0;
+    uint64_t mask=expand ? DoublePixels(opaque) << 16 : (uint64_t)opaque << 40;
+    int x=pLine->spriteX[sprite];
+
+    uint64_t others=GetSpriteWindow(taken,x);
+    if (mask & others)
+    {
+      spriteCollisions|=bit;
+      for (int other=0;other<sprite;other++)
       {
-        // Extended color mode?
-        if (value & 0b01000000)
+        int distance=x-pLine->spriteX[other];
+        if ((pLine->sprites & (1 << other)) && distance>-64 && distance<64 &&
+          (distance>=0 ? (masks[other] << distance) & mask : (mask << -distance) & masks[other]))
         {
-          HandleExtendedColorMode(); // extended color mode (ECM)?
-        }
-        else {
-          HandleTextMode(m_registerSetRead[0x16] & 0b00010000); // multicolor text mode?
+          spriteCollisions|=1 << other;
         }
       }
-      else 
+    }
+    OrSpriteWindow(taken,x,mask);
+    masks[sprite]=mask;
+    if (!visible)
+    {
+      continue;
+    }
+
+    int px=x-24; // X 24 is the first pixel of the display window
+    uint64_t foreground=GetForegroundWindow(pLine->foreground,px);
+    if (mask & foreground)
+    {
+      backgroundCollisions|=bit;
+    }
+    uint64_t draw=mask & ~others;
+    if (pLine->d01b & bit)
+    {
+      draw&=~foreground;
+    }
+    uint8_t colors[4]={0,pLine->spriteMulticolor[0],pLine->spriteColor[sprite],pLine->spriteMulticolor[1]};
+    while (draw)
+    {
+      int pixel=__builtin_clzll(draw);
+      draw&=~(0x8000000000000000ull >> pixel);
+      int column=px+pixel+VIC_FRAME_BORDER;
+      if (column<0 || column>=VIC_FRAME_WIDTH)
+      {
+        continue;
+      }
+      uint8_t color=pLine->spriteColor[sprite];
+      if (pLine->d01c & bit)
       {
-        HandleHiresModes(m_registerSetRead[0x16] & 0b00010000);
+        color=colors[(pixels >> (22-2*((pixel >> expand) >> 1))) & 3];
       }
+      uint8_t *pPixels=pFrameLine+(column >> 1);
+      *pPixels=(column & 1) ? (*pPixels & 0xf0) | color : (*pPixels & 0x0f) | (color << 4);
     }
   }
-}  
+  pLine->collisions=spriteCollisions | (backgroundCollisions << 8);
+}
+
+// $DD00 bits 0-1 select one of the four 16k banks
+static const uint16_t bankAddr[4]={0xc000,0x8000,0x4000,0x0000};
+
+/**
+ * The 16k the VIC sees in each bank as 1k slices of RAM, CHARGEN replaces $1000-$1FFF of the
+ * banks at $0000 and $8000. The RAM does not move, so the views are set up once.
+ */
+void VIC6569::BuildBankViews()
+{
+  for (int bank=0;bank<4;bank++)
+  {
+    for (int slice=0;slice<16;slice++)
+    {
+      uint16_t offset=slice*0x400;
+      if ((bankAddr[bank]==0x0000 || bankAddr[bank]==0x8000) && (offset & 0xf000)==0x1000)
+      {
+        m_bankView[bank][slice]=chargen_rom+offset-0x1000;
+      }
+      else
+      {
+        m_bankView[bank][slice]=m_pGlue->m_pRAM+bankAddr[bank]+offset;
+      }
+    }
+  }
+}
 
 /**
  * ECM with only 64 characters
  * 
 */
-void __not_in_flash_func (VIC6569::HandleExtendedColorMode)()
+void __not_in_flash_func (VIC6569::HandleExtendedColorMode)(VicLine *pLine, int first, int last)
 {
     uint8_t backgroundColors[4];
     
-    uint8_t *pCurrentLine=m_pFrameBuffer+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))*160);
-    uint16_t curRow=(m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))/8;
-    uint16_t scanbufferOffset=0;
+    uint8_t *pCurrentLine=GetLinePixels(pLine->line);
+    uint16_t curRow=pLine->graphicsLine/8;
+    uint16_t scanbufferOffset=first*4;
     
-    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset();
-    uint16_t vicBaseAddress=GetVideoRamStartAddr(false); // VIC bank physical address
+    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset(pLine);
+    const uint8_t * const *pBank=m_bankView[pLine->bank];
     uint8_t bits;
-    uint16_t videoRam=GetVideoRamAddrOffset()+vicBaseAddress; // 0x400...
+    uint16_t videoRam=GetVideoRamAddrOffset(pLine); // 0x400...
 
-    backgroundColors[0]=m_registerSetRead[0x21] & 0x0f;
-    backgroundColors[1]=m_registerSetRead[0x22] & 0x0f;
-    backgroundColors[2]=m_registerSetRead[0x23] & 0x0f;
-    backgroundColors[3]=m_registerSetRead[0x24] & 0x0f;
+    backgroundColors[0]=pLine->background[0] & 0x0f;
+    backgroundColors[1]=pLine->background[1] & 0x0f;
+    backgroundColors[2]=pLine->background[2] & 0x0f;
+    backgroundColors[3]=pLine->background[3] & 0x0f;
     uint8_t backgroundColor;
 
-    for (int i=0;i<40;i++) 
+    for (int i=first;i<last;i++) 
     {
       int offset=curRow*40+i;
       
-      uint8_t characterInVideoRam=m_pGlue->m_pRAM[videoRam+offset];
+      uint8_t characterInVideoRam=FetchByte(pBank,videoRam+offset);
       uint8_t foregroundColor=m_pGlue->m_pColorRam[offset] & 0x0f;
       backgroundColor=backgroundColors[characterInVideoRam/64];
       characterInVideoRam%=64;
      
-      if ((characterRamOffset==0x1000 || characterRamOffset==0x1800) && (vicBaseAddress==0x0000 || vicBaseAddress==0x8000))
-      {
-        bits=chargen_rom[(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)+characterRamOffset-0x1000];
-      }
-      else
-      {
-        bits=m_pGlue->m_pRAM[vicBaseAddress+characterRamOffset+(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)];
-      }
-
-      if (bits & 0x80)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x40)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      
-      scanbufferOffset++;
+      bits=FetchByte(pBank,characterRamOffset+(8*characterInVideoRam)+(pLine->graphicsLine % 8));
 
-      if (bits & 0x20)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x10)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-
-      if (bits & 0x8)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x4)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-      if (bits & 0x2)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x1)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
+      ExpandHires(pCurrentLine+scanbufferOffset,bits,foregroundColor,backgroundColor);
+      pLine->foreground[i]=bits;
+      scanbufferOffset+=4;
   } 
 }
 
 
-void __not_in_flash_func (VIC6569::HandleMulticolorTextMode)()
+void __not_in_flash_func (VIC6569::HandleMulticolorTextMode)(VicLine *pLine, int first, int last)
 {
-    uint8_t *pCurrentLine=m_pFrameBuffer+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))*160);
-    uint16_t curRow=(m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))/8;
-    uint16_t scanbufferOffset=0;
-    uint8_t pixel;
+    uint8_t *pCurrentLine=GetLinePixels(pLine->line);
+    uint16_t curRow=pLine->graphicsLine/8;
+    uint16_t scanbufferOffset=first*4;
 
-    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset();
-    uint16_t vicBaseAddress=GetVideoRamStartAddr(false); // VIC bank physical address
+    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset(pLine);
+    const uint8_t * const *pBank=m_bankView[pLine->bank];
     uint8_t bits;
-    uint16_t videoRam=GetVideoRamAddrOffset()+vicBaseAddress; // 0x400...
+    uint16_t videoRam=GetVideoRamAddrOffset(pLine); // 0x400...
 
-    uint8_t backgroundColor=m_registerSetRead[0x21] & 0x0f;
-    uint8_t color1=m_registerSetRead[0x22] & 0x0f; // 01
-    uint8_t color2=m_registerSetRead[0x23] & 0x0f; // 10
+    uint8_t backgroundColor=pLine->background[0] & 0x0f;
+    uint8_t colors[4]; // 00, 01, 10, 11 (color RAM, per character)
+    colors[0]=backgroundColor*0x11;
+    colors[1]=(pLine->background[1] & 0x0f)*0x11;
+    colors[2]=(pLine->background[2] & 0x0f)*0x11;
     
-    for (int i=0;i<40;i++) 
+    for (int i=first;i<last;i++) 
     {
       int offset=curRow*40+i;
       
-      uint8_t characterInVideoRam=m_pGlue->m_pRAM[videoRam+offset];
+      uint8_t characterInVideoRam=FetchByte(pBank,videoRam+offset);
 
-      if ((characterRamOffset==0x1000 || characterRamOffset==0x1800) && (vicBaseAddress==0x0000 || vicBaseAddress==0x8000))
-      {
-        bits=chargen_rom[(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)+characterRamOffset-0x1000];
-      }
-      else
-      {
-        bits=m_pGlue->m_pRAM[vicBaseAddress+characterRamOffset+(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)];
-      }
+      bits=FetchByte(pBank,characterRamOffset+(8*characterInVideoRam)+(pLine->graphicsLine % 8));
       
-      uint8_t color3=m_pGlue->m_pColorRam[curRow*40+i] % 0b00001111; // 11
+      // Bit 3 selects multicolor for this character, bits 0-2 are the %11 or foreground color
+      uint8_t colorRam=m_pGlue->m_pColorRam[curRow*40+i] & 0x0f;
+      uint8_t color3=colorRam & 0x07;
 
-      if (color3 & 8)
+      if (colorRam & 8)
       {
-          // this character has to be drawn in multicolor mode.
-          // We have 8 bits forming 4 pixel
-          for (int j=0;j<4;j++)
-          {
-            pixel=bits & 0xc0;
-            switch (pixel)
-            {
-              case 0x00:
-                pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-                pCurrentLine[scanbufferOffset]|=backgroundColor;
-              break;
-              case 0x40:
-                pCurrentLine[scanbufferOffset]=color1 << 4;
-                pCurrentLine[scanbufferOffset]|=color1;
-              break;
-              case 0x80:
-                pCurrentLine[scanbufferOffset]=color2 << 4;
-                pCurrentLine[scanbufferOffset]|=color2;
-              break;
-              case 0xc0:
-                pCurrentLine[scanbufferOffset]=color3 << 4;
-                pCurrentLine[scanbufferOffset]|=color3;
-              break;
-            }
-            scanbufferOffset++;
-            bits<<=2;
-          }
+        // this character has to be drawn in multicolor mode, 8 bits form 4 pixels
+        colors[3]=color3*0x11;
+        ExpandMulticolor(pCurrentLine+scanbufferOffset,bits,colors);
+        pLine->foreground[i]=MulticolorForeground(bits);
       }
       else  // standard text
       {
-        if (bits & 0x80)
-        {
-          pCurrentLine[scanbufferOffset]=color3 << 4;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-        }        
-        if (bits & 0x40)
-        {
-          pCurrentLine[scanbufferOffset]|=color3;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]|=backgroundColor;
-        }        
-        
-        scanbufferOffset++;
-
-        if (bits & 0x20)
-        {
-          pCurrentLine[scanbufferOffset]=color3 << 4;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-        }        
-        if (bits & 0x10)
-        {
-          pCurrentLine[scanbufferOffset]|=color3;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]|=backgroundColor;
-        }        
-        scanbufferOffset++;
-
-        if (bits & 0x8)
-        {
-          pCurrentLine[scanbufferOffset]=color3 << 4;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-        }        
-        if (bits & 0x4)
-        {
-          pCurrentLine[scanbufferOffset]|=color3;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]|=backgroundColor;
-        }        
-        scanbufferOffset++;
-        if (bits & 0x2)
-        {
-          pCurrentLine[scanbufferOffset]=color3 << 4;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-        }        
-        if (bits & 0x1)
-        {
-          pCurrentLine[scanbufferOffset]|=color3;
-        }
-        else
-        {
-          pCurrentLine[scanbufferOffset]|=backgroundColor;
-        }        
-        scanbufferOffset++;
+        ExpandHires(pCurrentLine+scanbufferOffset,bits,color3,backgroundColor);
+        pLine->foreground[i]=bits;
       }
+      scanbufferOffset+=4;
   } 
 }
 
-void __not_in_flash_func (VIC6569::HandleStandardTextMode)()
+void __not_in_flash_func (VIC6569::HandleStandardTextMode)(VicLine *pLine, int first, int last)
 {
-    uint8_t *pCurrentLine=m_pFrameBuffer+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))*160);
-    uint16_t curRow=(m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1))/8;
-    uint16_t scanbufferOffset=0;
-    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset();
-    uint16_t vicBaseAddress=GetVideoRamStartAddr(false); // VIC bank physical address
+    uint8_t *pCurrentLine=GetLinePixels(pLine->line);
+    uint16_t curRow=pLine->graphicsLine/8;
+    uint16_t scanbufferOffset=first*4;
+    uint16_t characterRamOffset=GetTextModeCharRamAddrOffset(pLine);
+    const uint8_t * const *pBank=m_bankView[pLine->bank];
     uint8_t bits;
-    uint16_t videoRam=GetVideoRamAddrOffset()+vicBaseAddress; // 0x400...
+    uint16_t videoRam=GetVideoRamAddrOffset(pLine); // 0x400...
     
-    for (int i=0;i<40;i++) 
+    for (int i=first;i<last;i++) 
     {
       int offset=curRow*40+i;
       
-      uint8_t characterInVideoRam=m_pGlue->m_pRAM[videoRam+offset];
+      uint8_t characterInVideoRam=FetchByte(pBank,videoRam+offset);
       
-      if ((characterRamOffset==0x1000 || characterRamOffset==0x1800) && (vicBaseAddress==0x0000 || vicBaseAddress==0x8000))
-      {
-        bits=chargen_rom[(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)+characterRamOffset-0x1000];
-      }
-      else
-      {
-        bits=m_pGlue->m_pRAM[vicBaseAddress+characterRamOffset+(8*characterInVideoRam)+((m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1)) % 8)];
-      }
+      bits=FetchByte(pBank,characterRamOffset+(8*characterInVideoRam)+(pLine->graphicsLine % 8));
 
       uint8_t foregroundColor=m_pGlue->m_pColorRam[offset] & 0x0f;
-      uint8_t backgroundColor=m_registerSetRead[0x21] & 0x0f;
-      
-      if (bits & 0x80)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x40)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
+      uint8_t backgroundColor=pLine->background[0] & 0x0f;
       
-      scanbufferOffset++;
-
-      if (bits & 0x20)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x10)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-
-      if (bits & 0x8)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x4)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-      if (bits & 0x2)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x1)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
+      ExpandHires(pCurrentLine+scanbufferOffset,bits,foregroundColor,backgroundColor);
+      pLine->foreground[i]=bits;
+      scanbufferOffset+=4;
   } 
 }
 
-void __not_in_flash_func (VIC6569::HandleTextMode)(bool multicolor)
+void __not_in_flash_func (VIC6569::HandleTextMode)(VicLine *pLine, bool multicolor, int first, int last)
 {
     if (multicolor)
     {
-        HandleMulticolorTextMode();
+        HandleMulticolorTextMode(pLine,first,last);
     }    
     else
     {
-        HandleStandardTextMode();
+        HandleStandardTextMode(pLine,first,last);
+    }
+}
+
+
+/** Where to find the bitmap.
+ *  $d018- bit 3 (bitmap mode)
+ */
+uint16_t __not_in_flash_func (VIC6569::GetBitmapAddrOffset)(const VicLine *pLine)
+{
+  return (pLine->d018 & 0b00001000) ? 0x2000 : 0x0000;
+}
+
+/** Where to find the charset character definition.
+ *  $d018- bits 1-3 (text mode)
+ */
+uint16_t __not_in_flash_func  (VIC6569::GetTextModeCharRamAddrOffset)(const VicLine *pLine)
+{
+  static uint16_t table[8]={0x0000,0x0800,0x1000,0x1800,0x2000,0x2800,0x3000,0x3800};
+  return table[(pLine->d018>>1) & 0x07];
+}
+
+/**
+ *  Video RAM (Text) bits 4..7 of 0xd018
+*/
+uint16_t __not_in_flash_func (VIC6569::GetVideoRamAddrOffset)(const VicLine *pLine)
+{
+  static uint16_t table[16]={0x0000,0x0400,0x0800,0x0c00,0x1000,0x1400,0x1800,0x1c00,0x2000,0x2400,0x2800,0x2c00,0x3000,0x3400,0x3800,0x3c00};
+  return table[(pLine->d018>>4) & 0b00001111];
+}
+
+void __not_in_flash_func (VIC6569::HandleHiresModes)(VicLine *pLine, bool multicolor, int first, int last)
+{
+  if (multicolor)
+  {
+    HandleMulticolorBitmapMode(pLine,first,last);
+  } 
+  else
+  {
+    HandleStandardBitmapMode(pLine,first,last);
+  }    
+}
+
+/**
+ * Standard Bitmap mode is 320x200/16
+*/
+void __not_in_flash_func (VIC6569::HandleStandardBitmapMode)(VicLine *pLine, int first, int last)
+{
+    uint8_t scanLine=pLine->graphicsLine;
+    uint8_t *pCurrentLine=GetLinePixels(pLine->line);
+    const uint8_t * const *pBank=m_bankView[pLine->bank];
+    uint16_t curRow=(scanLine/8); // 0-24
+    uint16_t scanbufferOffset=first*4;
+    uint16_t curVidMem=GetBitmapAddrOffset(pLine)+(curRow*320)+first*8;
+    curVidMem+=(scanLine % 8);
+    uint8_t bits;
+    uint16_t videoRamAddrOffset=GetVideoRamAddrOffset(pLine); // 0x400,0x800...
+
+    for (int i=first;i<last;i++) 
+    {
+      bits=FetchByte(pBank,curVidMem);
+
+      uint8_t colors=FetchByte(pBank,videoRamAddrOffset+(curRow*40+i));
+      uint8_t foregroundColor=(colors & 0b11110000) >> 4;
+      uint8_t backgroundColor=colors & 0b00001111;
+      
+      ExpandHires(pCurrentLine+scanbufferOffset,bits,foregroundColor,backgroundColor);
+      pLine->foreground[i]=bits;
+      scanbufferOffset+=4;
+      curVidMem+=8;
+    }
+}
+
+
+/**
+*   Multicolor Bitmap Mode is 160x200/16
+*/
+void __not_in_flash_func (VIC6569::HandleMulticolorBitmapMode)(VicLine *pLine, int first, int last)
+{
+    uint8_t scanLine=pLine->graphicsLine;
+    uint8_t *pCurrentLine=GetLinePixels(pLine->line);
+    const uint8_t * const *pBank=m_bankView[pLine->bank];
+    uint16_t curRow=(scanLine/8); // 0-24
+    uint16_t scanbufferOffset=first*4;
+    uint16_t curVidMem=GetBitmapAddrOffset(pLine)+(curRow*320)+first*8;
+    uint16_t videoRamAddrOffset=GetVideoRamAddrOffset(pLine); // 0x400,0x800...
+
+    curVidMem+=(scanLine % 8);
+    uint8_t bits;
+
+    uint8_t colors[4]; // 00, 01, 10, 11
+    colors[0]=(pLine->background[0] & 0b00001111)*0x11;
+
+    for (int i=first;i<last;i++) 
+    {
+      uint8_t videoRamColors=FetchByte(pBank,videoRamAddrOffset+(curRow*40+i));
+      colors[1]=((videoRamColors & 0b11110000) >> 4)*0x11; // 01
+      colors[2]=(videoRamColors & 0b00001111)*0x11; // 10
+      colors[3]=(m_pGlue->m_pColorRam[curRow*40+i] & 0b00001111)*0x11; // 11
+
+
+      bits=FetchByte(pBank,curVidMem);
+
+      ExpandMulticolor(pCurrentLine+scanbufferOffset,bits,colors);
+      pLine->foreground[i]=MulticolorForeground(bits);
+      scanbufferOffset+=4;
+      curVidMem+=8;      
+    }
+}
+
+/**
+ * The cycles of the current line the CPU is stopped for: the 40 cycles of a badline and two per
+ * sprite shown on the line (s-accesses, sprites 0-2 in the last six cycles, 58-63 on the 6569
+ * and 60-65 on the 6567R8, and 3-7 in cycles 1-10). The 6510 may still write in the three cycles
+ * after BA has gone low, the 65C02 simply gets no clock in the cycles the VIC uses the bus.
+ */
+void __not_in_flash_func (VIC6569::GetStallMask)(uint64_t *pStallMask)
+{
+  pStallMask[0]=0;
+  pStallMask[1]=0;
+  uint8_t d011=m_registerSetRead[0x11];
+  if ((d011 & 0x10) && m_currentScanLine>=0x30 && m_currentScanLine<=0xf7 && (m_currentScanLine & 7)==(d011 & 7))
+  {
+    pStallMask[0]=BADLINE_STALL_MASK;
+  }
+  uint8_t sprites=m_spritesOnLine[m_currentScanLine] & m_registerSetRead[0x15];
+  for (int sprite=0;sprites!=0;sprite++,sprites>>=1)
+  {
+    if (sprites & 1)
+    {
+      int first=(m_cyclesPerLine-6+2*sprite) % m_cyclesPerLine;
+      for (int cycle=first;cycle<first+2;cycle++)
+      {
+        pStallMask[cycle >> 6]|=1ull << (cycle & 63);
+      }
     }
+  }
 }
 
+// Scheduler event, called every m_cyclesPerLine cycles
+void __not_in_flash_func (VIC6569::NextLine) (uint64_t cycle) 
+{
+  CompareVerticalBorder(); // cycle 63 of the line that ends
+  m_currentScanLine++;
+
+  if (m_currentScanLine>=m_lines)
+  {
+    m_currentScanLine=0;
+    m_registerSetRead[0x11]&=0x7F;
+    m_registerSetRead[0x12]=0;
+  }
+  else if (m_currentScanLine>0xFF)
+  {
+    m_registerSetRead[0x11]|=0x80;
+    m_registerSetRead[0x12]=m_currentScanLine % 0x100;
+  }
+  else 
+  {
+    m_registerSetRead[0x11]&=0b01111111;
+    m_registerSetRead[0x12]=m_currentScanLine;
+  }
+  m_pGlue->m_writeStamp++;
+  uint64_t stallMask[VIC_STALL_WORDS];
+  GetStallMask(stallMask);
+  m_pGlue->SetStall(cycle,stallMask,m_cyclesPerLine);
+  QueueLine();
+  m_lineStartCycle=cycle;
+  CompareVerticalBorder(); // left edge of the new line
+  TakeSnapshot(&m_line);
+}
 
-/* CIA-B $DD00 bits 0..1 define the four possible 16k banks */
-uint16_t __not_in_flash_func (VIC6569::GetVideoRamStartAddr)(bool bitmapMode)
+/**
+ * The raster compare is not done every line: when $D012 or $D011 bit 7 change, the cycle the
+ * raster counter reaches them is scheduled, from then on it repeats every frame. The counter
+ * only wraps to line 0 in cycle 1 of the line, so line 0 matches one cycle later. Writing the
+ * line the counter is in matches at once, but not twice in a line.
+ */
+void __not_in_flash_func (VIC6569::UpdateRasterCompare)()
 {
-  static uint16_t addrTab[4]={0xc000,0x8000,0x4000,0x0000};
-  uint16_t addr=addrTab[m_pGlue->m_pCIA2->ReadRegister(0) & 0b00000011];
-  if (bitmapMode)
+  uint16_t compare=m_registerSetWrite[0x12] | ((m_registerSetWrite[0x11] & 0x80) << 1);
+  if (compare==m_rasterCompare)
+  {
+    return;
+  }
+  m_rasterCompare=compare;
+  Scheduler *pScheduler=m_pGlue->m_pScheduler;
+  if (compare>=m_lines)
+  {
+    pScheduler->Cancel(EventVicRaster); // never reached
+    return;
+  }
+  uint32_t frameCycles=m_cyclesPerLine*m_lines;
+  uint64_t cycle=m_lineStartCycle+((compare+m_lines-m_currentScanLine) % m_lines)*m_cyclesPerLine+(compare==0 ? 1 : 0);
+  if (cycle<=m_pGlue->GetCycle())
   {
-    if (m_registerSetRead[0x18] & 0b00001000)
+    if (cycle!=m_rasterMatchCycle)
     {
-      addr+=0x2000;
+      RasterMatch(cycle);
     }
+    cycle+=frameCycles;
   }
-  
-  return (addr);
+  pScheduler->Schedule(EventVicRaster,cycle,frameCycles);
 }
 
-uint16_t videoRamStartAddr=0;
-
-
-/** Where to find the charset character definition.
- *  $d018- bits 1-3 (text mode)
- */
-uint16_t __not_in_flash_func  (VIC6569::GetTextModeCharRamAddrOffset)()
+// Scheduler event, the raster counter has reached the compare line
+void __not_in_flash_func (VIC6569::RasterMatch)(uint64_t cycle)
 {
-  static uint16_t table[8]={0x0000,0x0800,0x1000,0x1800,0x2000,0x2800,0x3000,0x3800};
-  return table[(m_registerSetRead[0x18]>>1) & 0x07];
+  m_rasterMatchCycle=cycle;
+  m_registerSetRead[0x19]|=0x01;
+  UpdateIRQ();
 }
 
 /**
- *  Video RAM (Text) bits 4..7 of 0xd018
-*/
-uint16_t __not_in_flash_func (VIC6569::GetVideoRamAddrOffset)()
+ * $D019 bits 0-3 latch the raster, sprite-background, sprite-sprite and light pen sources, bit 7
+ * and IRQ follow the latched sources enabled in $D01A. IRQ is only released when the VIC was the
+ * one pulling it, the CIA1 shares the line.
+ */
+void __not_in_flash_func (VIC6569::UpdateIRQ)()
 {
-  static uint16_t table[16]={0x0000,0x0400,0x0800,0x0c00,0x1000,0x1400,0x1800,0x1c00,0x2000,0x2400,0x2800,0x2c00,0x3000,0x3400,0x3800,0x3c00};
-  return table[(m_registerSetRead[0x18]>>4) & 0b00001111];
+  bool wasActive=m_registerSetRead[0x19] & 0x80;
+  uint8_t latched=m_registerSetRead[0x19] & 0x0f;
+  if (latched & m_registerSetWrite[0x1a])
+  {
+    m_registerSetRead[0x19]=latched | 0x80;
+    m_pGlue->SignalIRQ(true);
+  }
+  else
+  {
+    m_registerSetRead[0x19]=latched;
+    if (wasActive)
+    {
+      m_pGlue->SignalIRQ(false);
+    }
+  }
 }
 
-void __not_in_flash_func (VIC6569::HandleHiresModes)(bool multicolor)
+/**
+ * The vertical border flip-flop is set when the line reaches the bottom compare value (RSEL: 251,
+ * else 247) and reset at the top one (51 or 55) if the display is on. Switching RSEL in the lines
+ * in between opens the upper and lower border.
+ */
+void __not_in_flash_func (VIC6569::CompareVerticalBorder)()
 {
-  if (multicolor)
+  uint8_t d011=m_registerSetRead[0x11];
+  if (m_currentScanLine==((d011 & 0b00001000) ? 251 : 247))
   {
-    HandleMulticolorBitmapMode();
-  } 
-  else
+    m_verticalBorder=true;
+  }
+  else if (m_currentScanLine==((d011 & 0b00001000) ? 51 : 55) && (d011 & 0x10))
   {
-    HandleStandardBitmapMode();
-  }    
+    m_verticalBorder=false;
+  }
 }
 
 /**
- * Standard Bitmap mode is 320x200/16
-*/
-void __not_in_flash_func (VIC6569::HandleStandardBitmapMode)()
+ * The main border flip-flop over the line that has just ended. It is reset at the left compare
+ * (X 24, or X 31 with 38 columns) unless the vertical border flip-flop is set, and set at the
+ * right one (X 344, or X 335). Switching to 38 columns between X 335 and X 344 misses both and
+ * opens the side border up to the left compare of the next line.
+ */
+void __not_in_flash_func (VIC6569::UpdateWindow)(VicLine *pLine)
 {
-    uint8_t scanLine=m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1);
-    uint8_t *pCurrentLine=m_pFrameBuffer+((scanLine)*160);
-    videoRamStartAddr=GetVideoRamStartAddr(true);
-    uint16_t vicBaseAddr=GetVideoRamStartAddr(false);
-    uint16_t curRow=(scanLine/8); // 0-24
-    uint16_t scanbufferOffset=0;
-    uint16_t curVidMem=videoRamStartAddr+(curRow*320);
-    curVidMem+=(scanLine % 8);
-    uint8_t bits;
-    uint16_t videoRamAddrOffset=GetVideoRamAddrOffset(); // 0x400,0x800...
-
-    for (int i=0;i<40;i++) 
+  uint8_t window=pLine->window;
+  if (!m_mainBorder)
+  {
+    window|=VIC_WINDOW_OPEN_LEFT;
+  }
+  if (!(pLine->d016 & 0b00001000))
+  {
+    window|=VIC_WINDOW_LEFT38;
+  }
+  // CSEL at X 335 and X 344, writes take effect from the cell shown in the next cycle on
+  uint8_t csel38=pLine->d016 & 0b00001000;
+  uint8_t csel40=csel38;
+  for (int change=0;change<pLine->changes;change++)
+  {
+    const VicChange *pChange=&pLine->change[change];
+    if (pChange->reg==0x16)
     {
-      if (vicBaseAddr==0x0000 || vicBaseAddr==0x8000) // Bank 0,2
+      if (pChange->cycle<=VIC_FIRST_CELL_CYCLE+38)
       {
-        if (curVidMem>=vicBaseAddr+0x1000 && curVidMem<=vicBaseAddr+0x2000)
-        {
-          bits=chargen_rom[(curVidMem-0x1000)];
-        }
-        else
-        {
-          bits=m_pGlue->m_pRAM[curVidMem];  
-        }
+        csel38=pChange->value & 0b00001000;
       }
-      else
+      if (pChange->cycle<=VIC_FIRST_CELL_CYCLE+40)
       {
-        bits=m_pGlue->m_pRAM[curVidMem];
+        csel40=pChange->value & 0b00001000;
       }
+    }
+  }
+  if (!csel38)
+  {
+    window|=VIC_WINDOW_RIGHT38;
+  }
+  else if (!csel40)
+  {
+    window|=VIC_WINDOW_OPEN_RIGHT;
+  }
+  m_mainBorder=!(window & VIC_WINDOW_OPEN_RIGHT);
+  pLine->window=window;
+}
 
-      uint8_t foregroundColor=(m_pGlue->m_pRAM[vicBaseAddr+videoRamAddrOffset+(curRow*40+i)] & 0b11110000) >> 4;
-      uint8_t backgroundColor=m_pGlue->m_pRAM[vicBaseAddr+videoRamAddrOffset+(curRow*40+i)] & 0b00001111;
-      
-      if (bits & 0x80)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x40)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      
-      scanbufferOffset++;
+/**
+ * Registers the renderer uses written during the line, with the cycle of the line. If the log
+ * is full, the remaining writes show up from the next line on.
+ */
+void __not_in_flash_func (VIC6569::LogChange)(uint8_t reg, uint8_t value)
+{
+  if (m_line.changes<VIC_LINE_CHANGES)
+  {
+    uint64_t cycle=m_pGlue->GetCycle()-m_lineStartCycle;
+    VicChange *pChange=&m_line.change[m_line.changes++];
+    pChange->cycle=cycle<m_cyclesPerLine ? cycle : m_cyclesPerLine;
+    pChange->reg=reg;
+    pChange->value=value;
+  }
+}
 
-      if (bits & 0x20)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x10)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
+void __not_in_flash_func (VIC6569::SetBank)(uint8_t bank)
+{
+  m_bank=bank & 0b00000011;
+  LogChange(VIC_CHANGE_BANK,m_bank);
+}
 
-      if (bits & 0x8)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x4)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-      if (bits & 0x2)
-      {
-        pCurrentLine[scanbufferOffset]=foregroundColor << 4;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-      }        
-      if (bits & 0x1)
-      {
-        pCurrentLine[scanbufferOffset]|=foregroundColor;
-      }
-      else
-      {
-        pCurrentLine[scanbufferOffset]|=backgroundColor;
-      }        
-      scanbufferOffset++;
-      curVidMem+=8;
-    }
+// Forget what the display lines were rendered from, for memory written behind the CPU's back
+void VIC6569::InvalidateLines()
+{
+  memset(m_lineSource,0,sizeof(m_lineSource));
 }
 
+// Has the CPU written the VIC memory at offset in the bank of the line since the stamp?
+bool __not_in_flash_func (VIC6569::IsWritten)(const VicLine *pLine, uint16_t offset, uint16_t length, uint64_t since)
+{
+  uint16_t addr=bankAddr[pLine->bank]+offset;
+  for (int page=addr >> 8;page<=(addr+length-1) >> 8;page++)
+  {
+    if (m_pGlue->m_pageWritten[page]>=since)
+    {
+      return true;
+    }
+  }
+  return false;
+}
 
 /**
-*   Multicolor Bitmap Mode is 160x200/16
-*/
-void __not_in_flash_func (VIC6569::HandleMulticolorBitmapMode)()
+ * A line without sprites shows the same pixels as on its last rendering if its registers are the
+ * same and the CPU has not written to the screen RAM row, the character set or the bitmap row and
+ * the color RAM row since. Lines with sprites are always rendered and the next rendering of that
+ * line as well, to remove them. Updates the source of the line if it has to be rendered.
+ */
+bool __not_in_flash_func (VIC6569::IsLineUnchanged)(const VicLine *pLine)
 {
-    uint8_t scanLine=m_currentScanLine-(END_SCANLINE_UPPER_BORDER_PAL+1);
-    uint8_t *pCurrentLine=m_pFrameBuffer+((scanLine)*160);
-    videoRamStartAddr=GetVideoRamStartAddr(true);
-    uint16_t curRow=(scanLine/8); // 0-24
-    uint16_t scanbufferOffset=0;
-    uint16_t curVidMem=videoRamStartAddr+(curRow*320);
-    uint16_t vicBaseAddr=GetVideoRamStartAddr(false);
-    uint16_t videoRamAddrOffset=GetVideoRamAddrOffset(); // 0x400,0x800...
-
-    curVidMem+=(scanLine % 8);
-    uint8_t bits;
-
-    uint8_t backgroundColor=m_registerSetRead[0x21] & 0b00001111; // 00
-    uint8_t pixel;
+  bool visible=pLine->line>=VIC_FRAME_FIRST_LINE && pLine->line<VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES;
+  if (!visible)
+  {
+    return false;
+  }
+#ifdef _FRAME_PACING
+  VicLineSource *pSource=&m_lineSource[m_renderedFrame][pLine->line-VIC_FRAME_FIRST_LINE];
+#else
+  VicLineSource *pSource=&m_lineSource[0][pLine->line-VIC_FRAME_FIRST_LINE];
+#endif
+  uint64_t since=pSource->stamp;
+  if (pLine->sprites || pLine->changes)
+  {
+    pSource->stamp=0;
+    return false;
+  }
+  pSource->stamp=m_pGlue->m_writeStamp;
+  if (since==0 || memcmp(pSource->registers,&pLine->d011,sizeof(pSource->registers))!=0)
+  {
+    memcpy(pSource->registers,&pLine->d011,sizeof(pSource->registers));
+    return false;
+  }
+  int graphicsLine=pLine->line-0x30-(pLine->d011 & 0x07);
+  if (!(pLine->d011 & 0x10) || (pLine->window & VIC_WINDOW_BORDER) || graphicsLine<0 || graphicsLine>=200)
+  {
+    return true; // border, idle, background or black only
+  }
+  uint16_t row=(graphicsLine/8)*40;
+  if (IsWritten(pLine,GetVideoRamAddrOffset(pLine)+row,40,since) ||
+    m_pGlue->m_pageWritten[0xd8+(row >> 8)]>=since || m_pGlue->m_pageWritten[0xd8+((row+39) >> 8)]>=since)
+  {
+    return false;
+  }
+  if (pLine->d011 & 0b00100000)
+  {
+    return !IsWritten(pLine,GetBitmapAddrOffset(pLine)+row*8,320,since);
+  }
+  return !IsWritten(pLine,GetTextModeCharRamAddrOffset(pLine),0x800,since);
+}
 
-    for (int i=0;i<40;i++) 
+void __not_in_flash_func (VIC6569::TakeSnapshot)(VicLine *pLine)
+{
+  pLine->line=m_currentScanLine;
+  pLine->d011=m_registerSetRead[0x11];
+  pLine->d016=m_registerSetRead[0x16];
+  pLine->d018=m_registerSetRead[0x18];
+  pLine->bank=m_bank;
+  pLine->background[0]=m_registerSetRead[0x21] & 0x0f;
+  pLine->background[1]=m_registerSetRead[0x22] & 0x0f;
+  pLine->background[2]=m_registerSetRead[0x23] & 0x0f;
+  pLine->background[3]=m_registerSetRead[0x24] & 0x0f;
+  pLine->border=m_registerSetRead[0x20] & 0x0f;
+  pLine->window=m_verticalBorder ? VIC_WINDOW_BORDER : 0;
+  pLine->changes=0;
+  pLine->sprites=m_spritesOnLine[m_currentScanLine] & m_registerSetRead[0x15];
+  if (pLine->sprites)
+  {
+    pLine->d01b=m_registerSetRead[0x1b];
+    pLine->d01c=m_registerSetRead[0x1c];
+    pLine->d01d=m_registerSetRead[0x1d];
+    pLine->spriteMulticolor[0]=m_registerSetRead[0x25] & 0x0f;
+    pLine->spriteMulticolor[1]=m_registerSetRead[0x26] & 0x0f;
+    for (int sprite=0;sprite<8;sprite++)
     {
-      uint8_t color1=(m_pGlue->m_pRAM[vicBaseAddr+videoRamAddrOffset+(curRow*40+i)] & 0b11110000) >> 4; // 01
-      uint8_t color2=m_pGlue->m_pRAM[vicBaseAddr+videoRamAddrOffset+(curRow*40+i)] & 0b00001111; // 10
-      uint8_t color3=m_pGlue->m_pColorRam[curRow*40+i] & 0b00001111; // 11
+      pLine->spriteColor[sprite]=m_registerSetRead[0x27+sprite] & 0x0f;
+      pLine->spriteRow[sprite]=(m_currentScanLine-m_spriteTop[sprite]) >> ((m_registerSetRead[0x17] >> sprite) & 1);
+      pLine->spriteX[sprite]=m_registerSetRead[2*sprite] | (((m_registerSetRead[0x10] >> sprite) & 1) << 8);
+    }
+  }
+}
 
+/**
+ * Hands the registers of the current line to core1 (RenderQueuedLine). If core1 is
+ * behind, or there is no core1 (host build), the line is rendered right here.
+ */
+// The line that has just ended, with the register writes of the line
+void __not_in_flash_func (VIC6569::QueueLine)()
+{
+  VicLine *pLine=&m_line;
+  CollectCollisions();
+  UpdateWindow(pLine);
+#ifdef _RACE_THE_BEAM
+  if (pLine->line>=VIC_FRAME_FIRST_LINE && pLine->line<VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES)
+  {
+    PublishLine(pLine); // rendered by core1 when the DVI output gets there
+  }
+  else if (pLine->sprites)
+  {
+    Render(pLine); // not shown, only the collisions
+    TakeCollisions(pLine->collisions);
+  }
+  return;
+#endif
+#ifdef _FRAME_PACING
+  bool shown=pLine->line>=VIC_FRAME_FIRST_LINE && pLine->line<VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES;
+  // Complete once core1 has rendered the last lines, at the latest before the next frame starts
+  if (m_frameStarted && (shown ? pLine->line==VIC_FRAME_FIRST_LINE : m_lineTail==m_lineHead))
+  {
+    CompleteFrame();
+  }
+  m_frameStarted|=shown;
+#endif
+  if ((pLine->line<VIC_FRAME_FIRST_LINE || pLine->line>=VIC_FRAME_FIRST_LINE+VIC_FRAME_LINES) && !pLine->sprites)
+  {
+    return; // not shown, no sprites that could collide
+  }
+  if (IsLineUnchanged(pLine))
+  {
+    m_linesSkipped++;
+    return; // the frame buffer still holds this line
+  }
+  m_linesRendered++;
+  uint32_t head=m_lineHead;
+  if (VIC_RENDER_INLINE || head-m_lineTail>=VIC_LINE_QUEUE_SIZE)
+  {
+    Render(pLine);
+    TakeCollisions(pLine->collisions);
+    m_linesRenderedInline++;
+    return;
+  }
+  m_lineQueue[head & (VIC_LINE_QUEUE_SIZE-1)]=*pLine;
+  __dmb();
+  m_lineHead=head+1;
+}
 
-      if (vicBaseAddr==0x0000 || vicBaseAddr==0x8000) // Bank 0,2
-      {
-        if (curVidMem>=vicBaseAddr+0x1000 && curVidMem<=vicBaseAddr+0x2000)
-        {
-          bits=chargen_rom[(curVidMem-0x1000)];
-        }
-        else
-        {
-          bits=m_pGlue->m_pRAM[curVidMem];  
-        }
-      }
-      else
-      {
-        bits=m_pGlue->m_pRAM[curVidMem];
-      }
+// Core1, between two DVI scanlines
+bool __not_in_flash_func (VIC6569::RenderQueuedLine)()
+{
+  uint32_t tail=m_lineTail;
+  if (tail==m_lineHead)
+  {
+    return false;
+  }
+  __dmb();
+  Render(&m_lineQueue[tail & (VIC_LINE_QUEUE_SIZE-1)]);
+  __dmb();
+  m_lineTail=tail+1;
+  return true;
+}
 
-      for (int j=0;j<4;j++)
-      {
-        pixel=bits & 0xc0;
-        switch (pixel)
-        {
-          case 0x00:
-            pCurrentLine[scanbufferOffset]=backgroundColor << 4;
-            pCurrentLine[scanbufferOffset]|=backgroundColor;
-          break;
-          case 0x40:
-            pCurrentLine[scanbufferOffset]=color1 << 4;
-            pCurrentLine[scanbufferOffset]|=color1;
-          break;
-          case 0x80:
-            pCurrentLine[scanbufferOffset]=color2 << 4;
-            pCurrentLine[scanbufferOffset]|=color2;
-          break;
-          case 0xc0:
-            pCurrentLine[scanbufferOffset]=color3 << 4;
-            pCurrentLine[scanbufferOffset]|=color3;
-          break;
-        }
-        scanbufferOffset++;
-        bits<<=2;
-      }
-      curVidMem+=8;      
-    }
+// Collisions of the lines core1 has rendered since the last call
+void __not_in_flash_func (VIC6569::CollectCollisions)()
+{
+#ifdef _RACE_THE_BEAM
+  uint32_t head=m_raceCollisionHead;
+  __dmb();
+  while (m_lineCollected!=head)
+  {
+    TakeCollisions(m_raceCollisions[m_lineCollected & (VIC_LINE_QUEUE_SIZE-1)]);
+    m_lineCollected++;
+  }
+#else
+  uint32_t tail=m_lineTail;
+  __dmb();
+  while (m_lineCollected!=tail)
+  {
+    TakeCollisions(m_lineQueue[m_lineCollected & (VIC_LINE_QUEUE_SIZE-1)].collisions);
+    m_lineCollected++;
+  }
+#endif
 }
 
+#ifdef _FRAME_PACING
+/**
+ * Core0, hands the frame rendered to the DVI output and renders the next one into the frame
+ * buffer it neither shows nor has been handed. If it takes more than one frame before the DVI
+ * output starts its next frame, the frames before are skipped.
+ */
+void __not_in_flash_func (VIC6569::CompleteFrame)()
+{
+  while (m_lineTail!=m_lineHead); // core1 still renders the last lines
+  __dmb();
+  uint8_t latest=m_renderedFrame;
+  m_latestFrame=latest;
+  __dmb();
+  uint8_t shown=m_shownFrame;
+  m_renderedFrame=latest!=shown ? 3-latest-shown : (latest+1)%3;
+  m_pFrameBuffer=m_pFrameBuffers+m_renderedFrame*VIC_FRAME_SIZE;
+  m_frameStarted=false;
+  m_framesCompleted++;
+}
 
-void __not_in_flash_func (VIC6569::Clk) () 
+/**
+ * Core1, at the start of each DVI frame: the last complete frame, or the one shown before
+ * again. Announcing the frame first and checking it is still the last one afterwards keeps
+ * CompleteFrame() from choosing it to render into.
+ */
+const uint8_t * __not_in_flash_func (VIC6569::NextShownFrame)()
 {
-  static int irqAtScanline;
-  m_i64Clks++;
+  uint8_t previous=m_shownFrame;
+  uint8_t latest;
+  do
+  {
+    latest=m_latestFrame;
+    m_shownFrame=latest;
+    __dmb();
+  } while (latest!=m_latestFrame);
+  m_framesShown++;
+  if (latest==previous)
+  {
+    m_framesRepeated++;
+  }
+  return m_pFrameBuffers+latest*VIC_FRAME_SIZE;
+}
+#endif
 
-  // Every 63 clocks the VIC starts a new line
-  
-  if (m_i64Clks % CLOCKS_PER_HLINE==0)
-  {   
-    m_currentScanLine++;
+#ifdef _RACE_THE_BEAM
+// Core0, the registers of a shown line for core1
+void __not_in_flash_func (VIC6569::PublishLine)(const VicLine *pLine)
+{
+  uint16_t row=pLine->line-VIC_FRAME_FIRST_LINE;
+  uint32_t seq=m_frameLineSeq[row];
+  m_frameLineSeq[row]=seq+1;
+  __dmb();
+  memcpy(m_frameLines[row],pLine,sizeof(m_frameLines[row]));
+  __dmb();
+  m_frameLineSeq[row]=seq+2;
+}
 
-    if (m_currentScanLine>NUM_OF_VLINES_PAL)
-    {
-      m_currentScanLine=0;
-      m_registerSetRead[0x11]&=0x7F;
-      m_registerSetRead[0x12]=0;
-    }
-    else if (m_currentScanLine>0xFF)
+/**
+ * Core1, between two DVI scanlines: renders a line the DVI output will show, at least one and
+ * at most VIC_RACE_LINES-2 lines ahead of it. The line at the beam is never rendered, its slot
+ * is the one NextRaceLine() hands out next, from the DMA IRQ that can interrupt Render(). If
+ * core1 has fallen behind (or has just started), it skips to the line after the beam.
+ */
+bool __not_in_flash_func (VIC6569::RenderRaceLine)()
+{
+  uint32_t shown=m_raceShown;
+  uint32_t rendered=m_raceRendered;
+  if ((int32_t)(rendered-shown)<=0)
+  {
+    rendered=shown+1;
+  }
+  if (rendered-shown>=VIC_RACE_LINES-1)
+  {
+    return false;
+  }
+  uint16_t row=rendered % VIC_FRAME_LINES;
+  VicLine line;
+  uint32_t seq;
+  do
+  {
+    seq=m_frameLineSeq[row];
+    __dmb();
+    memcpy(&line,m_frameLines[row],sizeof(m_frameLines[row]));
+    __dmb();
+  } while ((seq & 1) || seq!=m_frameLineSeq[row]);
+  Render(&line);
+  // Lines are shown more than once, a collision only counts the first time
+  if (line.collisions && seq!=m_frameLineReported[row])
+  {
+    m_frameLineReported[row]=seq;
+    uint32_t head=m_raceCollisionHead;
+    if (head-m_lineCollected<VIC_LINE_QUEUE_SIZE)
     {
-      m_registerSetRead[0x11]|=0x80;
-      m_registerSetRead[0x12]|=m_currentScanLine % 0x100;
+      m_raceCollisions[head & (VIC_LINE_QUEUE_SIZE-1)]=line.collisions;
+      __dmb();
+      m_raceCollisionHead=head+1;
     }
-    else 
+  }
+  __dmb();
+  m_raceRendered=rendered+1;
+  return true;
+}
+
+/**
+ * Core1, DVI scanline callback: the frame buffer line it shows next. RenderRaceLine() only
+ * renders the lines after it, so the line stays as it is until it has been converted.
+ */
+const uint8_t * __not_in_flash_func (VIC6569::NextRaceLine)()
+{
+  uint32_t shown=m_raceShown;
+  m_raceShown=shown+1;
+  return m_pFrameBuffer+(shown & (VIC_RACE_LINES-1))*VIC_FRAME_PITCH;
+}
+#endif
+
+// Only the first collision after $D01E/$D01F have been read raises an IRQ
+void __not_in_flash_func (VIC6569::TakeCollisions)(uint16_t collisions)
+{
+  if (collisions==0)
+  {
+    return;
+  }
+  uint8_t irq=0;
+  if (collisions & 0xff)
+  {
+    if (m_registerSetRead[0x1e]==0)
     {
-      m_registerSetRead[0x11]&=0b01111111;
-      m_registerSetRead[0x12]=m_currentScanLine;
+      irq|=0x04;
     }
-    // Now check if we need to signal an IRQ due to vertical line count
-    
-    irqAtScanline=m_registerSetWrite[0x12]; // registerSetWrite: When shall the next IRQ occur?
-    if (m_registerSetWrite[0x11] & 0x80)
+    m_registerSetRead[0x1e]|=collisions & 0xff;
+  }
+  if (collisions >> 8)
+  {
+    if (m_registerSetRead[0x1f]==0)
     {
-      irqAtScanline+=256;
+      irq|=0x02;
     }
+    m_registerSetRead[0x1f]|=collisions >> 8;
+  }
+  m_registerSetRead[0x19]|=irq;
+  UpdateIRQ();
+}
 
-    if (irqAtScanline==m_currentScanLine)
-    {
-      m_registerSetRead[0x19]|=0x01; /// Signal that the rasterline has been reached
-      if (m_registerSetWrite[0x1a] & 0x01)
-      {
-        static uint16_t prevLine=0;
-        m_registerSetRead[0x19]|=0x80;
-        if (prevLine!=irqAtScanline)
-        {
-          prevLine=irqAtScanline;
-        }
-        m_pGlue->SignalIRQ(true);
-      }
-    }
+// Moves a sprite in m_spritesOnLine, it starts on the raster line after its Y coordinate
+void VIC6569::UpdateSpriteLines(int sprite)
+{
+  uint8_t bit=1 << sprite;
+  for (int line=m_spriteTop[sprite];line<m_spriteTop[sprite]+m_spriteHeight[sprite];line++)
+  {
+    m_spritesOnLine[line]&=~bit;
+  }
+  m_spriteTop[sprite]=m_registerSetRead[1+2*sprite]+1;
+  m_spriteHeight[sprite]=(m_registerSetRead[0x17] & bit) ? 42 : 21;
+  for (int line=m_spriteTop[sprite];line<m_spriteTop[sprite]+m_spriteHeight[sprite];line++)
+  {
+    m_spritesOnLine[line]|=bit;
+  }
+}
+
+uint8_t __not_in_flash_func (VIC6569::ReadRegister)(uint8_t reg)
+{
+  if (reg>=sizeof(m_registerSetRead))
+  {
+    return 0xff; // $D02F-$D03F are not connected
   }
-  if (m_i64Clks % CLOCKS_PER_HLINE==0 || m_i64Clks==1) {
-    m_borderColor[m_currentScanLine]=m_registerSetRead[0x20];
-    UpdateFrameBuffer(); // Update every scanline
+  uint8_t value=m_registerSetRead[reg];
+  if (reg==0x1e || reg==0x1f)
+  {
+    m_registerSetRead[reg]=0; // collisions are cleared by reading them
   }
+  return value;
 }
 
 // reg 0x16 Bit 3, 40 (1) or 38 columns (0)
 void VIC6569::WriteRegister(uint8_t reg, uint8_t value)
 {
+  if (reg>=sizeof(m_registerSetRead))
+  {
+    return;
+  }
+  if (reg==0x11 || reg==0x16 || reg==0x18 || (reg>=0x20 && reg<=0x24))
+  {
+    LogChange(reg,value);
+  }
   switch (reg)
   {
     case 0x19:
-      m_registerSetWrite[reg]=~value;
-      m_registerSetRead[reg]=m_registerSetWrite[reg];
-      if (!(value & 0x01)) 
-      {
-        m_pGlue->SignalIRQ(false);   
-      }
+      m_registerSetWrite[reg]=value;
+      m_registerSetRead[reg]&=~(value & 0x0f); // a 1 acknowledges a latched source, bit 7 follows
+      UpdateIRQ();
     break;
 
     case 0x1a:
       m_registerSetWrite[reg]=value;
+      UpdateIRQ(); // a source that is still latched raises IRQ at once, disabling all releases it
     break;
 
     case 0x11:
       m_registerSetWrite[reg]=value;
-      m_registerSetRead[reg]=value;  
+      m_registerSetRead[reg]=(value & 0x7f) | (m_registerSetRead[reg] & 0x80); // bit 7 reads bit 8 of the raster counter
+      UpdateRasterCompare();
     break;
     case 0x12:
       m_registerSetWrite[reg]=value;
+      UpdateRasterCompare();
+    break;
+    case 0x17:
+      m_registerSetRead[reg]=value;
+      for (int sprite=0;sprite<8;sprite++)
+      {
+        UpdateSpriteLines(sprite);
+      }
     break;
+    case 0x1e:
+    case 0x1f:
+    break; // read only
     default:
       m_registerSetRead[reg]=value;  
+      if (reg<0x10 && (reg & 1)) // sprite Y coordinate
+      {
+        UpdateSpriteLines(reg >> 1);
+      }
   }
  
 }
@@ -2,45 +2,270 @@
 #ifndef VIC6569_HXX_
 #define VIC6569_HXX_
 
-#define CLOCKS_PER_HLINE 63
-#define NUM_OF_VLINES_PAL 312 // 0 based, 311 is last line
-#define LAST_VLINE_PAL 311 
+#define VIC_MAX_LINES 312 // raster lines of the 6569, the most of all models
 #define END_SCANLINE_UPPER_BORDER_PAL 50
 #define START_SCANLINE_LOWER_BORDER_PAL 251
 
+#define VIC_LINE_QUEUE_SIZE 16 // power of 2
+// The host build has no core1 taking lines from the queue, core0 renders each line itself
+#ifdef _HOST
+#define VIC_RENDER_INLINE true
+#else
+#define VIC_RENDER_INLINE false
+#endif
+
+// The frame buffer holds the raster lines and pixels the DVI output shows (340x240) and a few
+// border pixels more, so the display window (X 24-343) starts at a 32-bit aligned byte
+#define VIC_FRAME_FIRST_LINE 31 // raster line of frame buffer line 0
+#define VIC_FRAME_LINES 240
+#define VIC_FRAME_BORDER 16 // pixels left and right of the display window
+#define VIC_FRAME_WIDTH (320+2*VIC_FRAME_BORDER)
+#define VIC_FRAME_PITCH (VIC_FRAME_WIDTH/2)
+
+// _RACE_THE_BEAM: no frame buffer, core1 renders the lines from their registers just before the
+// DVI output shows them, into a ring of a few frame buffer lines
+#ifdef _RACE_THE_BEAM
+#define VIC_RACE_LINES 4 // power of 2, divides VIC_FRAME_LINES
+#define VIC_FRAME_BUFFER_LINES VIC_RACE_LINES
+#else
+#define VIC_FRAME_BUFFER_LINES VIC_FRAME_LINES
+#endif
+
+// _FRAME_PACING: the VIC renders into one frame buffer, the DVI output shows another one and
+// takes the last complete frame at the start of each of its frames
+#ifdef _FRAME_PACING
+#ifdef _RACE_THE_BEAM
+#error "_FRAME_PACING needs the frame buffer _RACE_THE_BEAM does without"
+#endif
+#define VIC_FRAME_BUFFERS 3 // rendered, last complete and shown
+#else
+#define VIC_FRAME_BUFFERS 1
+#endif
+#define VIC_FRAME_SIZE (VIC_FRAME_PITCH*VIC_FRAME_BUFFER_LINES)
+#define VIC_LINE_FILL_MIXED 0xff // GetLineFill(): the frame buffer line is not in one colour
+
+// VicLine::window, where the main border flip-flop lets the graphics and sprites through
+#define VIC_WINDOW_BORDER 0x01     // vertical border flip-flop set, the main one is not reset
+#define VIC_WINDOW_OPEN_LEFT 0x02  // main border flip-flop not set at the end of the line before
+#define VIC_WINDOW_LEFT38 0x04     // left compare at X 31
+#define VIC_WINDOW_RIGHT38 0x08    // right compare at X 335
+#define VIC_WINDOW_OPEN_RIGHT 0x10 // neither right compare has set the main border flip-flop
+
+#define VIC_LINE_CHANGES 8 // register writes within a line the renderer replays
+#define VIC_CHANGE_BANK 0xff // $DD00 in a VicChange
+#define VIC_FIRST_CELL_CYCLE 15 // a write in this cycle of the line is shown from the first cell on
+
+// Cycles of a raster line (bit 0 of word 0: first cycle) the VIC takes the bus from the CPU,
+// two words as the 6567R8 has 65 cycles
+#define VIC_STALL_WORDS 2
+#define BADLINE_STALL_MASK (((1ull << 40)-1) << 14) // c-accesses, cycles 15-54, in word 0
+
 class RpPetra;
+
+// The VIC models, they differ in the raster line timing and in the system clock they are used with
+typedef enum {
+  Vic6569,    // PAL
+  Vic6567R8,  // NTSC
+  Vic6567R56A // early NTSC
+} VicModel;
+
+typedef struct {
+  uint8_t cyclesPerLine;
+  uint16_t lines;
+  uint32_t clockHz;
+  const char *pName; // the VIC type SIDSetVicType() takes
+} VicTiming;
+
+// A register written during a line, cycle of the line and register number
+typedef struct {
+  uint8_t cycle;
+  uint8_t reg;
+  uint8_t value;
+} VicChange;
+
+// Registers a display line is rendered with, taken by NextLine() on core0 at the start of the
+// line, and the writes during the line
+typedef struct {
+  uint16_t line;
+  uint8_t d011;
+  uint8_t d016;
+  uint8_t d018;
+  uint8_t bank;          // $DD00 bits 0-1
+  uint8_t background[4]; // $D021-$D024
+  uint8_t border;        // $D020
+  uint8_t window;        // VIC_WINDOW_..., 0: 40 columns
+  uint8_t sprites;       // enabled sprites with a row on this line, 0: the sprite fields are not set
+  uint8_t d01b;
+  uint8_t d01c;
+  uint8_t d01d;
+  uint8_t spriteMulticolor[2]; // $D025, $D026
+  uint8_t spriteColor[8];      // $D027-$D02E
+  uint8_t spriteRow[8];        // data row 0-20 of each sprite
+  uint16_t spriteX[8];
+  uint8_t changes;
+  VicChange change[VIC_LINE_CHANGES];
+  // Written by Render(): the line within the 200 graphics lines (YSCROLL), graphics pixels that
+  // are not background (sprite priority and collisions), and the collisions found, $D01E in
+  // bits 0-7 and $D01F in bits 8-15
+  uint8_t graphicsLine;
+  uint8_t foreground[40];
+  uint16_t collisions;
+} VicLine;
+
+// What a display line without sprites was last rendered from: the stamp of the line it was
+// taken on (RpPetra::m_writeStamp, 0: render again) and $D011 to window as in VicLine
+typedef struct {
+  uint64_t stamp;
+  uint8_t registers[offsetof(VicLine,window)-offsetof(VicLine,d011)+1];
+} VicLineSource;
  
 class VIC6569 {
   
   private:  
     Logging *m_pLog;
     RpPetra *m_pGlue; 
-    uint64_t m_i64Clks;
     uint8_t m_registerSetWrite[0x2f];
     uint16_t m_currentScanLine;
-    uint8_t *m_pFrameBuffer;
-
-    void UpdateFrameBuffer();
-    void HandleTextMode(bool multicolor);
-    void HandleHiresModes(bool multicolor);
-    void HandleStandardBitmapMode();
-    void HandleMulticolorBitmapMode();
-    void HandleStandardTextMode();
-    void HandleMulticolorTextMode();
-    void HandleExtendedColorMode();
-    uint16_t GetVideoRamStartAddr(bool bitmapMode);
-    inline uint16_t GetTextModeCharRamAddrOffset();
-    inline uint16_t GetVideoRamAddrOffset();
+    uint8_t *m_pFrameBuffer; // the one the VIC renders into
+#ifdef _FRAME_PACING
+    uint8_t *m_pFrameBuffers;
+    uint8_t m_renderedFrame;             // core0
+    volatile uint8_t m_latestFrame;      // last complete one, written by core0
+    volatile uint8_t m_shownFrame;       // written by core1
+    bool m_frameStarted;                 // shown lines have been rendered into m_renderedFrame
+    uint32_t m_framesCompleted;
+    volatile uint32_t m_framesShown;
+    volatile uint32_t m_framesRepeated;
+#endif
+    VicModel m_model;
+    uint8_t m_cyclesPerLine;
+    uint16_t m_lines;
+
+    // Lines waiting for core1, single producer (core0), single consumer (core1)
+    VicLine m_lineQueue[VIC_LINE_QUEUE_SIZE];
+    VicLine m_line; // the current line, queued when it is over
+    uint64_t m_lineStartCycle;
+    uint16_t m_rasterCompare;    // $D012 and $D011 bit 7 as written, 0xffff: not set up
+    uint64_t m_rasterMatchCycle; // cycle of the last raster compare match
+    bool m_verticalBorder; // border flip-flops
+    bool m_mainBorder;
+    volatile uint32_t m_lineHead;
+    volatile uint32_t m_lineTail;
+    uint32_t m_linesRenderedInline;
+    uint32_t m_lineCollected; // queue entries whose collisions were taken over
+
+    // Display lines are only rendered again if a register or memory they show has changed
+    VicLineSource m_lineSource[VIC_FRAME_BUFFERS][VIC_FRAME_LINES];
+    uint32_t m_linesRendered;
+    uint32_t m_linesSkipped;
+    // Colour of each frame buffer line that is border only (upper and lower border, display off)
+    uint8_t m_lineFill[VIC_FRAME_BUFFERS*VIC_FRAME_BUFFER_LINES];
+
+    // Sprites whose Y range covers a raster line, kept up to date on writes to $D001-$D00F and $D017
+    uint8_t m_spritesOnLine[VIC_MAX_LINES];
+    uint16_t m_spriteTop[8];
+    uint8_t m_spriteHeight[8];
+
+#ifdef _RACE_THE_BEAM
+    // The shown lines as last taken by core0, VicLine up to the fields Render() writes, each
+    // behind a sequence number that is odd while core0 writes the line. Core1 hands the
+    // collisions of each line it renders to core0 once.
+    uint8_t m_frameLines[VIC_FRAME_LINES][offsetof(VicLine,graphicsLine)];
+    volatile uint32_t m_frameLineSeq[VIC_FRAME_LINES];
+    uint32_t m_frameLineReported[VIC_FRAME_LINES];
+    volatile uint32_t m_raceRendered; // lines rendered by core1 since the start
+    volatile uint32_t m_raceShown;    // lines taken by the DVI output since the start
+    volatile uint16_t m_raceCollisions[VIC_LINE_QUEUE_SIZE];
+    volatile uint32_t m_raceCollisionHead;
+#endif
+
+    // $DD00 bits 0-1, set by CIA2, and the 16k each bank shows the VIC as 1k slices
+    uint8_t m_bank;
+    const uint8_t *m_bankView[4][16];
+
+    void TakeSnapshot(VicLine *pLine);
+    void QueueLine();
+#ifdef _FRAME_PACING
+    void CompleteFrame();
+#endif
+#ifdef _RACE_THE_BEAM
+    void PublishLine(const VicLine *pLine);
+#endif
+    void CompareVerticalBorder();
+    void UpdateRasterCompare();
+    void UpdateWindow(VicLine *pLine);
+    void LogChange(uint8_t reg, uint8_t value);
+    bool IsLineUnchanged(const VicLine *pLine);
+    bool IsWritten(const VicLine *pLine, uint16_t offset, uint16_t length, uint64_t since);
+    void CollectCollisions();
+    void TakeCollisions(uint16_t collisions);
+    void UpdateIRQ();
+    void UpdateSpriteLines(int sprite);
+    void RenderCells(VicLine *pLine, bool idle, int first, int last);
+    void ReplayChanges(VicLine *pLine, bool idle);
+    void RenderIdleLine(VicLine *pLine, int first, int last);
+    void ScrollLine(VicLine *pLine);
+    void DrawSprites(VicLine *pLine, bool visible);
+    void DrawWindow(VicLine *pLine);
+    uint8_t DrawBorder(VicLine *pLine, int from, int to);
+    void GetStallMask(uint64_t *pStallMask);
+    void BuildBankViews();
+    // A byte as the VIC sees it at offset 0-$3FFF of a bank view
+    inline uint8_t FetchByte(const uint8_t * const *pBank, uint16_t offset) { return pBank[offset >> 10][offset & 0x3ff];};
+    void HandleTextMode(VicLine *pLine, bool multicolor, int first, int last);
+    void HandleHiresModes(VicLine *pLine, bool multicolor, int first, int last);
+    void HandleStandardBitmapMode(VicLine *pLine, int first, int last);
+    void HandleMulticolorBitmapMode(VicLine *pLine, int first, int last);
+    void HandleStandardTextMode(VicLine *pLine, int first, int last);
+    void HandleMulticolorTextMode(VicLine *pLine, int first, int last);
+    void HandleExtendedColorMode(VicLine *pLine, int first, int last);
+    inline uint16_t GetBitmapAddrOffset(const VicLine *pLine);
+    inline uint16_t GetTextModeCharRamAddrOffset(const VicLine *pLine);
+    inline uint16_t GetVideoRamAddrOffset(const VicLine *pLine);
+    // Line of a frame buffer line counted from the first line of the first frame buffer
+#ifdef _FRAME_PACING
+    inline int GetFrameRow(const uint8_t *pFrameLine) { return (pFrameLine-m_pFrameBuffers)/VIC_FRAME_PITCH;};
+#else
+    inline int GetFrameRow(const uint8_t *pFrameLine) { return (pFrameLine-m_pFrameBuffer)/VIC_FRAME_PITCH;};
+#endif
   
   public:
     VIC6569(Logging *pLogging, RpPetra *pGlue);
     virtual ~VIC6569();
     void Reset();
-    void Clk();
+    void SetModel(VicModel model);
+    const VicTiming *GetTiming();
+    void NextLine(uint64_t cycle);
+    void RasterMatch(uint64_t cycle);
+    uint8_t ReadRegister(uint8_t reg);
     void WriteRegister(uint8_t reg, uint8_t value);
+    void SetBank(uint8_t bank);
+    bool RenderQueuedLine();
+#ifdef _FRAME_PACING
+    const uint8_t *NextShownFrame();
+    inline uint32_t GetFramesCompleted() { return m_framesCompleted;};
+    inline uint32_t GetFramesShown() { return m_framesShown;};
+    inline uint32_t GetFramesRepeated() { return m_framesRepeated;};
+#endif
+#ifdef _RACE_THE_BEAM
+    bool RenderRaceLine();
+    const uint8_t *NextRaceLine();
+#endif
+    void Render(VicLine *pLine);
+    void InvalidateLines();
+    inline uint32_t GetLinesRenderedInline() { return m_linesRenderedInline;};
+    inline uint32_t GetLinesRendered() { return m_linesRendered;};
+    inline uint32_t GetLinesSkipped() { return m_linesSkipped;};
     inline uint8_t *GetFrameBuffer() { return m_pFrameBuffer;};
+#ifdef _RACE_THE_BEAM
+    inline uint8_t *GetFrameLine(uint16_t line) { return m_pFrameBuffer+((line-VIC_FRAME_FIRST_LINE) & (VIC_RACE_LINES-1))*VIC_FRAME_PITCH;};
+#else
+    inline uint8_t *GetFrameLine(uint16_t line) { return m_pFrameBuffer+(line-VIC_FRAME_FIRST_LINE)*VIC_FRAME_PITCH;};
+#endif
+    inline uint8_t *GetLinePixels(uint16_t line) { return GetFrameLine(line)+VIC_FRAME_BORDER/2;}; // display window
+    // The colour a frame buffer line was last drawn in completely, or VIC_LINE_FILL_MIXED
+    inline uint8_t GetLineFill(const uint8_t *pFrameLine) { return m_lineFill[GetFrameRow(pFrameLine)];};
     uint8_t m_registerSetRead[0x2f];    
-    uint8_t m_borderColor[NUM_OF_VLINES_PAL];
 };
 
 #endif
\ No newline at end of file
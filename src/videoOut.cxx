@@ -5,11 +5,6 @@
 */
 #include "stdinclude.hxx"
 
-const int UPPER_BORDER_SIZE=10;
-const int LEFT_BORDER_SIZE=20;
-
-const int LAST_FRAMEBUFFER_LINE=240;
-
 // Timing for a generic 340x240 resolution (680x480, twin pixel)
 const struct dvi_timing dvi_timing_340x240p_60hz = {
 
@@ -35,16 +30,18 @@ static const struct dvi_serialiser_cfg picodvi_cfg = {
    .prog_offs=0
 };
 
-// C64 color schema as 565
-const uint16_t colorIndex[]={0x0000,0xffff,0x8187,0x7679,0x89f2,0x55e9,0x2973,0xef8e,0x9a85,0x51c0,0xC36E,0x4228,0x8c51,0x8ff1,0x8c5f,0xce59};
-
-uint8_t *frameBuffer;
+const uint8_t *frameBuffer;
 dvi_inst *g_pDVI; 
 uint16_t *pScanLine;
 uint16_t *pCurScanLine;
 
 RpPetra *_pGlue; 
 
+#ifdef _TMDS_PALETTE
+// TMDS symbols of the 16 colours for the three channels, see tmds_setup_palette24_symbols()
+static uint32_t tmdsPalette[16*6];
+#endif
+
 VideoOut::VideoOut(Logging *pLog, RpPetra *pGlue, uint8_t *pFrameBuffer)
 {
    m_pLog=pLog;
@@ -53,156 +50,77 @@ VideoOut::VideoOut(Logging *pLog, RpPetra *pGlue, uint8_t *pFrameBuffer)
    pScanLine=(uint16_t *)calloc(680+32,sizeof(uint16_t));
 }
 
+/**
+ * dvi_scanbuf_main_16bpp() of libdvi, but while waiting for the next scanline core1
+ * renders the lines the VIC has queued on core0 (_RACE_THE_BEAM: the lines the DVI output
+ * shows next). With _TMDS_PALETTE the scanlines hold one colour index per DVI pixel and are
+ * encoded with the precomputed symbols of the 16 colours instead of three 16bpp channel passes.
+ */
+static void __not_in_flash_func(scanbufMain)()
+{
+  uint pixwidth=g_pDVI->timing->h_active_pixels;
+#ifndef _TMDS_PALETTE
+  uint wordsPerChannel=pixwidth/DVI_SYMBOLS_PER_WORD;
+#endif
+  while (true)
+  {
+    uint32_t *pScanBuf;
+    while (!queue_try_remove_u32(&g_pDVI->q_colour_valid, &pScanBuf))
+    {
+#ifdef _RACE_THE_BEAM
+      _pGlue->m_pVICII->RenderRaceLine();
+#else
+      _pGlue->m_pVICII->RenderQueuedLine();
+#endif
+    }
+    uint32_t *pTmdsBuf;
+    queue_remove_blocking_u32(&g_pDVI->q_tmds_free, &pTmdsBuf);
+#ifdef _TMDS_PALETTE
+    tmds_encode_palette_data(pScanBuf, tmdsPalette, pTmdsBuf, pixwidth, SCANLINE_INDEX_BITS);
+#else
+    tmds_encode_data_channel_16bpp(pScanBuf, pTmdsBuf, pixwidth/2, DVI_16BPP_BLUE_MSB, DVI_16BPP_BLUE_LSB);
+    tmds_encode_data_channel_16bpp(pScanBuf, pTmdsBuf+wordsPerChannel, pixwidth/2, DVI_16BPP_GREEN_MSB, DVI_16BPP_GREEN_LSB);
+    tmds_encode_data_channel_16bpp(pScanBuf, pTmdsBuf+2*wordsPerChannel, pixwidth/2, DVI_16BPP_RED_MSB, DVI_16BPP_RED_LSB);
+#endif
+    queue_add_blocking_u32(&g_pDVI->q_tmds_valid, &pTmdsBuf);
+    queue_add_blocking_u32(&g_pDVI->q_colour_free, &pScanBuf);
+  }
+}
+
 static void __not_in_flash_func(core1_main)() {
    dvi_register_irqs_this_core(g_pDVI, DMA_IRQ_1);   
    dvi_start(g_pDVI);                       					
-   dvi_scanbuf_main_16bpp(g_pDVI);  
+   scanbufMain();  
 }
 
-/** Calculates a single scanline for DVI. We may switch to use the PIO coprocessor later on. */
+/**
+ * Calculates a single scanline for DVI. The VIC draws the border into the frame buffer as well,
+ * the 340 pixels in the middle of each of its lines are shown. Border only lines are not written
+ * again while the scanline buffer holds them in the same colour.
+ */
 static void __not_in_flash_func(beamRace)(void) 
 {
   static int currentBeamPos=0;
-  static int upperBorderStop;
-  static int lowerBorderStart;
-
-  upperBorderStop=10;
-  lowerBorderStart=211;
-    
-  uint16_t color=colorIndex[_pGlue->m_pVICII->m_borderColor[currentBeamPos+39] & 0x0f];
-  uint32_t *pP=(uint32_t *)pScanLine;
-  
-  uint32_t pixel=(color << 16 | color);
-  uint16_t idx=0;
-  // Blit the border(s) or blank the screen, 32-bits at a time (loop unrolled)
-  for (int i=0;i<8;i++) 
-  {
-    pP[idx]=pixel;
-    pP[idx+1]=pixel;
-    pP[idx+2]=pixel;
-    pP[idx+3]=pixel;
-    pP[idx+4]=pixel;
-    pP[idx+5]=pixel;
-    pP[idx+6]=pixel;
-    pP[idx+7]=pixel;
-    pP[idx+8]=pixel;
-    pP[idx+9]=pixel;
-    pP[idx+10]=pixel;
-    pP[idx+11]=pixel;
-    pP[idx+12]=pixel;
-    pP[idx+13]=pixel;
-    pP[idx+14]=pixel;
-    pP[idx+15]=pixel;
-    pP[idx+16]=pixel;
-    pP[idx+17]=pixel;
-    pP[idx+18]=pixel;
-    pP[idx+19]=pixel;
-    pP[idx+20]=pixel;
-    idx+=21;
-  }
-  // 336
-  pP[idx]=pixel;
-  pP[idx+1]=pixel;
+  static ScanLineCache scanLineCache={nullptr,VIC_LINE_FILL_MIXED};
 
   while (queue_try_remove_u32(&g_pDVI->q_colour_free, &pScanLine));  
   
-  if (_pGlue->m_pVICII->m_registerSetRead[0x11] & 0x10) // display not switched off completely...
+#ifdef _RACE_THE_BEAM
+  const uint8_t *pCurBuffer=_pGlue->m_pVICII->NextRaceLine();
+#else
+#ifdef _FRAME_PACING
+  if (currentBeamPos==0)
   {
-    uint16_t x=LEFT_BORDER_SIZE/2;
-    if ((_pGlue->m_pVICII->m_registerSetRead[0x11] & 0b00001000)==0) { // 24 lines only...
-      upperBorderStop+=4;
-      lowerBorderStart-=4;
-    }
-    if (currentBeamPos>upperBorderStop && currentBeamPos<lowerBorderStart)
-    {
-      uint8_t *pCurBuffer = frameBuffer+((currentBeamPos-UPPER_BORDER_SIZE-1)*160);
-      uint8_t pixel; 
-      if (_pGlue->m_pVICII->m_registerSetRead[0x16] & 0b00001000) // 40 cols
-      {
-        // 2 pixels encoded in 4-bits... This way we can easily support even VIC's FLI color modes later on...
-        for (int i=0;i<160;i+=8) { // 320 Pixel a 4 bit
-          pixel=pCurBuffer[i]; 
-          pScanLine[x]=colorIndex[pixel>>4];
-          pScanLine[x+1]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+1]; 
-          pScanLine[x+2]=colorIndex[pixel>>4];
-          pScanLine[x+3]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+2]; 
-          pScanLine[x+4]=colorIndex[pixel>>4];
-          pScanLine[x+5]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+3]; 
-          pScanLine[x+6]=colorIndex[pixel>>4];
-          pScanLine[x+7]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+4]; 
-          pScanLine[x+8]=colorIndex[pixel>>4];
-          pScanLine[x+9]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+5]; 
-          pScanLine[x+10]=colorIndex[pixel>>4];
-          pScanLine[x+11]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+6]; 
-          pScanLine[x+12]=colorIndex[pixel>>4];
-          pScanLine[x+13]=colorIndex[pixel & 15];
-
-          pixel=pCurBuffer[i+7]; 
-          pScanLine[x+14]=colorIndex[pixel>>4];
-          pScanLine[x+15]=colorIndex[pixel & 15];
-          x+=16;
-        }
-      }
-      else // 38 cols...
-      {
-        for (int i=0;i<160;i+=8)  // 320 Pixel a 4 bit
-        {
-          if (i>0)
-          {
-            pixel=pCurBuffer[i]; 
-            pScanLine[x]=colorIndex[pixel>>4];
-            pScanLine[x+1]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+1]; 
-            pScanLine[x+2]=colorIndex[pixel>>4];
-            pScanLine[x+3]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+2]; 
-            pScanLine[x+4]=colorIndex[pixel>>4];
-            pScanLine[x+5]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+3]; 
-            pScanLine[x+6]=colorIndex[pixel>>4];
-            pScanLine[x+7]=colorIndex[pixel & 15];
-          }
-          if (i<152)
-          {
-            pixel=pCurBuffer[i+4]; 
-            pScanLine[x+8]=colorIndex[pixel>>4];
-            pScanLine[x+9]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+5]; 
-            pScanLine[x+10]=colorIndex[pixel>>4];
-            pScanLine[x+11]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+6]; 
-            pScanLine[x+12]=colorIndex[pixel>>4];
-            pScanLine[x+13]=colorIndex[pixel & 15];
-
-            pixel=pCurBuffer[i+7]; 
-            pScanLine[x+14]=colorIndex[pixel>>4];
-            pScanLine[x+15]=colorIndex[pixel & 15];
-          }
-          x+=16;
-        }
-      }
-    }
+    frameBuffer=_pGlue->m_pVICII->NextShownFrame(); // last complete frame, or the same again
   }
+#endif
+  const uint8_t *pCurBuffer=frameBuffer+currentBeamPos*VIC_FRAME_PITCH;
+#endif
+  BuildScanLine(&scanLineCache,pCurBuffer,_pGlue->m_pVICII->GetLineFill(pCurBuffer),(uint32_t *)pScanLine);
+
   queue_add_blocking_u32(&g_pDVI->q_colour_valid, &pScanLine); 
 
-  if (++currentBeamPos==LAST_FRAMEBUFFER_LINE)
+  if (++currentBeamPos==VIC_FRAME_LINES)
   {
     currentBeamPos=0;
   }
@@ -219,6 +137,14 @@ void VideoOut::Reset()
   // vreg_set_voltage(VREG_VOLTAGE_1_30);                    				
   set_sys_clock_khz(g_pDVI->timing->bit_clk_khz, true); 
   dvi_init(g_pDVI,next_striped_spin_lock_num(), next_striped_spin_lock_num());
+#ifdef _TMDS_PALETTE
+  uint32_t palette24[16];
+  for (uint8_t color=0;color<16;color++)
+  {
+    palette24[color]=ColorRGB888(color);
+  }
+  tmds_setup_palette24_symbols(palette24, tmdsPalette, 16);
+#endif
   Start();
 }
 